@@ -13,3 +13,21 @@ CREATE TABLE games (
    broken       BOOLEAN NOT NULL DEFAULT FALSE,
    missing      BOOLEAN NOT NULL DEFAULT TRUE
 );
+
+CREATE INDEX games_listed ON games (hide, missing, name);
+
+-- one row for every launch, times are seconds since the epoch and the
+-- duration is in milliseconds
+CREATE TABLE sessions (
+   filename     TEXT NOT NULL,
+   exit_code    INTEGER NOT NULL,
+   started      INTEGER NOT NULL,
+   ended        INTEGER NOT NULL,
+   duration     INTEGER NOT NULL
+);
+
+-- lemon launcher upgrades older databases up to this version at startup
+CREATE TABLE schema_version (
+   version      INTEGER NOT NULL
+);
+INSERT INTO schema_version VALUES (2);
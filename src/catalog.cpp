@@ -0,0 +1,495 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "catalog.h"
+#include "error.h"
+#include "options.h"
+#include "log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <map>
+
+using namespace ll;
+using namespace std;
+
+/** Game as loaded, strings are pool offsets until the pool stops growing */
+struct game_row {
+   Uint32 rom, name, folded, params, genre, manufacturer, maker, parent;
+   int year, count;
+   long last_played;
+   bool favorite, broken;
+};
+
+/** Names of the sort keys in the config file, in sort_key_t order */
+static const char* key_names[] = {
+   "none", "name", "genre", "manufacturer", "year", "count", "last_played"
+};
+
+/** Names of the view filters in the config file, in view_filter_t order */
+static const char* filter_names[] = { "all", "favorite", "played", "recent" };
+
+/** Returns the index of name in names, -1 if it isn't one of them */
+static int lookup(const char* name, const char** names, int count)
+{
+   for (int i = 0; i < count; i++)
+      if (strcmp(name, names[i]) == 0)
+         return i;
+
+   return -1;
+}
+
+/** Appends a view with a single sort field to views */
+static void add_view(vector<view_def>& views, const char* title,
+      view_filter_t filter, sort_key_t group, sort_key_t key, bool descending)
+{
+   sort_field field = { key, descending };
+
+   view_def def;
+   def.title = title;
+   def.filter = filter;
+   def.group = group;
+   def.order.push_back(field);
+   views.push_back(def);
+}
+
+void ll::read_views(vector<view_def>& views)
+{
+   views.clear();
+
+   for (unsigned int v = 0; v < g_opts.get_size(KEY_VIEW); v++) {
+      cfg_t* sec = g_opts.get_section(KEY_VIEW, v);
+
+      view_def def;
+      def.title = cfg_title(sec);
+
+      int filter = lookup(cfg_getstr(sec, KEY_VIEW_FILTER), filter_names, 4);
+      int group = lookup(cfg_getstr(sec, KEY_VIEW_GROUP), key_names, key_last_played + 1);
+
+      if (filter < 0 || group < 0 || group == key_name ||
+            group == key_count || group == key_last_played ||
+            ((filter == filter_recent || filter == filter_favorite) &&
+             group != key_none)) {
+         log << error << "read_views: bad filter or group in view " << def.title << endl;
+         throw bad_lemon("options: invalid view");
+      }
+
+      def.filter = (view_filter_t)filter;
+      def.group = (sort_key_t)group;
+
+      // the group field sorts first, in the direction given for it if any
+      sort_field first = { def.group, false };
+      def.order.push_back(first);
+
+      for (unsigned int k = 0; k < cfg_size(sec, KEY_VIEW_SORT); k++) {
+         const char* name = cfg_getnstr(sec, KEY_VIEW_SORT, k);
+         sort_field field;
+         field.descending = *name == '-';
+
+         int key = lookup(name + field.descending, key_names, key_last_played + 1);
+         if (key <= key_none) {
+            log << error << "read_views: bad sort key " << name << " in view "
+                  << def.title << endl;
+            throw bad_lemon("options: invalid view");
+         }
+
+         field.key = (sort_key_t)key;
+
+         // favorite views are updated in place when a favorite is toggled,
+         // an order that changes with every launch would leave them stale
+         if (def.filter == filter_favorite &&
+               (field.key == key_count || field.key == key_last_played)) {
+            log << error << "read_views: favorite view " << def.title
+                  << " can't be sorted by " << name << endl;
+            throw bad_lemon("options: invalid view");
+         }
+
+         if (field.key == def.group)
+            def.order[0] = field;
+         else
+            def.order.push_back(field);
+      }
+
+      views.push_back(def);
+   }
+
+   // the views there were before they could be configured
+   if (views.empty()) {
+      add_view(views, "Favorites", filter_favorite, key_none, key_name, false);
+      add_view(views, "Most Played", filter_played, key_none, key_count, true);
+      add_view(views, "Recently Played", filter_recent, key_none, key_last_played, true);
+      add_view(views, "Genres", filter_all, key_genre, key_genre, false);
+      add_view(views, "All", filter_all, key_none, key_name, false);
+   }
+}
+
+int catalog::compare(sort_key_t key, Uint32 left, Uint32 right) const
+{
+   const game& l = _games[left];
+   const game& r = _games[right];
+
+   switch (key) {
+   case key_name:
+      return strcmp(l.text(), r.text());
+
+   case key_genre:
+      return strcmp(l.genre(), r.genre());
+
+   case key_manufacturer:
+      // the same maker is often spelt with different case
+      return strcmp(_makers[left], _makers[right]);
+
+   case key_year:
+      return l.year() - r.year();
+
+   case key_count:
+      return l.count() - r.count();
+
+   case key_last_played:
+      return l.last_played() < r.last_played()? -1 :
+            l.last_played() > r.last_played()? 1 : 0;
+
+   default:
+      return 0;
+   }
+}
+
+bool catalog::view_order::operator()(Uint32 left, Uint32 right) const
+{
+   int cmp = 0;
+
+   for (vector<sort_field>::const_iterator f = def->order.begin();
+         cmp == 0 && f != def->order.end(); f++) {
+      cmp = c->compare(f->key, left, right);
+      if (f->descending)
+         cmp = -cmp;
+   }
+
+   // the name and then the index break ties so every game has exactly one
+   // position in a view
+   if (cmp == 0)
+      cmp = c->compare(key_name, left, right);
+
+   return cmp != 0? cmp < 0 : left < right;
+}
+
+/** Orders game indexes by when they were last played, newest first */
+struct by_last_played {
+   const catalog* c;
+
+   by_last_played(const catalog* cat) : c(cat) { }
+
+   bool operator()(Uint32 left, Uint32 right) const
+   {
+      long l = c->at(left)->last_played(), r = c->at(right)->last_played();
+      return l != r? l > r : left < right;
+   }
+};
+
+/** Lowercases the string in place */
+static void fold(char* str)
+{
+   for (; *str; str++)
+      *str = tolower((unsigned char)*str);
+}
+
+catalog::catalog(stmt_cache& stmts, bool show_hidden, const vector<view_def>& defs) :
+   _defs(defs), _views(defs.size())
+{
+   Uint32 start = SDL_GetTicks();
+
+   string query("SELECT filename, name, params, genre, count, favourite, broken, "
+         "manufacturer, year, strftime('%s', last_played), clone_of FROM games");
+   if (!show_hidden)
+      query.append(" WHERE hide = 0 AND missing = 0");
+
+   // streams from the games_listed index, which leaves the views close to
+   // sorted already
+   query.append(" ORDER BY name");
+
+   log << debug << "catalog: " << query << endl;
+
+   vector<game_row> rows;
+   map<string, Uint32> genres; // only a few dozen, pool each one once
+   map<string, Uint32> makers; // a few hundred, pooled as is then lowercase
+
+   _strings.push_back('\0'); // offset 0 is the empty string
+
+   sqlite3_stmt *stmt;
+   int rc;
+   try {
+      assert_sqlite(stmt = stmts.get(query.c_str()));
+      while ((rc = stmts.step(stmt)) == SQLITE_ROW) {
+         const char* rom = (char *)sqlite3_column_text(stmt, 0);
+         const char* name = (char *)sqlite3_column_text(stmt, 1);
+         const char* params = (char *)sqlite3_column_text(stmt, 2);
+         const char* genre = (char *)sqlite3_column_text(stmt, 3);
+         const char* maker = (char *)sqlite3_column_text(stmt, 7);
+         const char* parent = (char *)sqlite3_column_text(stmt, 10);
+
+         // hand edited databases can leave any of these NULL
+         if (!name) name = rom? rom : "";
+         if (!genre) genre = "Unknown";
+
+         map<string, Uint32>::iterator g = genres.find(genre);
+         if (g == genres.end())
+            g = genres.insert(make_pair(string(genre), pool(genre))).first;
+
+         if (!maker) maker = "";
+         map<string, Uint32>::iterator m = makers.find(maker);
+         if (m == makers.end()) {
+            m = makers.insert(make_pair(string(maker), pool(maker))).first;
+            pool(maker); // folded copy follows the original
+         }
+
+         game_row r;
+         r.rom = pool(rom);
+         r.name = pool(name);
+         r.folded = pool(name); // lowercased once the pool is final
+         r.params = params && *params? pool(params) : 0;
+         r.parent = parent && *parent? pool(parent) : 0;
+         r.genre = g->second;
+         r.manufacturer = m->second;
+         r.maker = m->second + strlen(maker) + 1;
+         r.year = sqlite3_column_int(stmt, 8);
+         r.last_played = (long)sqlite3_column_int64(stmt, 9); // NULL is 0
+         r.count = sqlite3_column_int(stmt, 4);
+         r.favorite = sqlite3_column_int(stmt, 5);
+         r.broken = sqlite3_column_int(stmt, 6);
+         rows.push_back(r);
+      }
+      assert_sqlite(rc == SQLITE_DONE);
+   } catch (sqlite_exception ex) {
+      throw bad_lemon(sqlite3_errmsg(stmts.db()));
+   }
+
+   // drop the slack left by growing, the pool is never appended to again
+   vector<char>(_strings).swap(_strings);
+
+   char* str = &_strings[0];
+   _games.reserve(rows.size());
+   _folded.reserve(rows.size());
+   _makers.reserve(rows.size());
+   _parents.reserve(rows.size());
+
+   for (map<string, Uint32>::iterator m = makers.begin(); m != makers.end(); m++)
+      fold(str + m->second + m->first.size() + 1);
+
+   for (vector<game_row>::iterator r = rows.begin(); r != rows.end(); r++) {
+      _games.push_back(game(str + r->rom, str + r->name, str + r->params,
+            str + r->genre, str + r->manufacturer, r->year, r->last_played,
+            r->count, r->favorite, r->broken));
+
+      // searches compare against lowercase names, fold them once up front
+      fold(str + r->folded);
+      _folded.push_back(str + r->folded);
+      _makers.push_back(str + r->maker);
+      _parents.push_back(str + r->parent);
+   }
+
+   // fill the ring with the games played last, from then on it only
+   // changes when a game is played
+   for (Uint32 i = 0; i < _games.size(); i++)
+      if (_games[i].last_played() > 0)
+         _recent.push_back(i);
+
+   size_t recent = min(_recent.size(), (size_t)RECENT_GAMES);
+   partial_sort(_recent.begin(), _recent.begin() + recent, _recent.end(), by_last_played(this));
+   _recent.resize(recent);
+
+   for (int v = 0; v < views(); v++) {
+      if (!sorted(v))
+         continue;
+
+      vector<Uint32>& indexes = _views[v];
+
+      for (Uint32 i = 0; i < _games.size(); i++)
+         if (member(v, _games[i]))
+            indexes.push_back(i);
+
+      sort(indexes.begin(), indexes.end(), view_order(this, v));
+   }
+
+   log << info << "catalog: loaded " << _games.size() << " games, "
+         << views() << " views in "
+         << SDL_GetTicks() - start << " ms, " << bytes() / 1024 << " KB" << endl;
+}
+
+Uint32 catalog::pool(const char* str)
+{
+   if (!str)
+      return 0; // the empty string
+
+   Uint32 offset = _strings.size();
+   _strings.insert(_strings.end(), str, str + strlen(str) + 1);
+   return offset;
+}
+
+size_t catalog::bytes() const
+{
+   size_t bytes = _games.capacity() * sizeof(game) + _strings.capacity() +
+         (_folded.capacity() + _makers.capacity() + _parents.capacity()) *
+         sizeof(const char*);
+
+   for (int v = 0; v < views(); v++)
+      bytes += _views[v].capacity() * sizeof(Uint32);
+   bytes += _recent.capacity() * sizeof(Uint32);
+
+   return bytes;
+}
+
+bool catalog::member(int view, const game& g) const
+{
+   switch (_defs[view].filter) {
+   case filter_favorite:
+      return g.is_favorite();
+
+   case filter_played:
+      return g.count() > 0;
+
+   case filter_recent:
+      return find(_recent.begin(), _recent.end(), index_of(&g)) != _recent.end();
+
+   default:
+      return true;
+   }
+}
+
+void catalog::detach(Uint32 index)
+{
+   for (int v = 0; v < views(); v++) {
+      if (!sorted(v) || !member(v, _games[index]))
+         continue;
+
+      vector<Uint32>& indexes = _views[v];
+      vector<Uint32>::iterator i = lower_bound(indexes.begin(), indexes.end(),
+            index, view_order(this, v));
+
+      if (i != indexes.end() && *i == index)
+         indexes.erase(i);
+   }
+}
+
+void catalog::attach(Uint32 index)
+{
+   for (int v = 0; v < views(); v++) {
+      if (!sorted(v) || !member(v, _games[index]))
+         continue;
+
+      vector<Uint32>& indexes = _views[v];
+      indexes.insert(upper_bound(indexes.begin(), indexes.end(), index,
+            view_order(this, v)), index);
+   }
+}
+
+int catalog::position(int view, const game* g) const
+{
+   if (!member(view, *g))
+      return -1;
+
+   Uint32 index = index_of(g);
+
+   if (!sorted(view))
+      return find(_recent.begin(), _recent.end(), index) - _recent.begin();
+
+   const vector<Uint32>& indexes = _views[view];
+   vector<Uint32>::const_iterator i = lower_bound(indexes.begin(),
+         indexes.end(), index, view_order(this, view));
+
+   return i != indexes.end() && *i == index? i - indexes.begin() : -1;
+}
+
+void catalog::group_title(int view, Uint32 index, string& title) const
+{
+   const game& g = _games[index];
+
+   switch (_defs[view].group) {
+   case key_genre:
+      title = g.genre();
+      break;
+
+   case key_manufacturer:
+      title = g.manufacturer();
+      break;
+
+   case key_year:
+      if (g.year() > 0) {
+         char year[12];
+         snprintf(year, sizeof(year), "%d", g.year());
+         title = year;
+      } else {
+         title = "Unknown";
+      }
+      break;
+
+   default:
+      title = _defs[view].title;
+      break;
+   }
+}
+
+bool catalog::follows_play(int view) const
+{
+   const view_def& def = _defs[view];
+
+   if (def.filter == filter_played || def.filter == filter_recent)
+      return true;
+
+   for (vector<sort_field>::const_iterator f = def.order.begin(); f != def.order.end(); f++)
+      if (f->key == key_count || f->key == key_last_played)
+         return true;
+
+   return false;
+}
+
+void catalog::toggle_favorite(game* g)
+{
+   Uint32 index = index_of(g);
+
+   // the game has to be found with the ordering it was inserted with
+   detach(index);
+   g->toggle_favorite();
+   attach(index);
+}
+
+void catalog::played(game* g, bool ok, long when)
+{
+   Uint32 index = index_of(g);
+
+   detach(index);
+
+   if (ok)
+      g->played(when);
+   g->set_broken(!ok);
+
+   attach(index);
+
+   // the game moves to the front of the ring, the oldest drops off the end
+   if (ok) {
+      vector<Uint32>::iterator i = find(_recent.begin(), _recent.end(), index);
+      if (i != _recent.end())
+         _recent.erase(i);
+      else if (_recent.size() >= RECENT_GAMES)
+         _recent.pop_back();
+
+      _recent.insert(_recent.begin(), index);
+   }
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef CATALOG_H_
+#define CATALOG_H_
+
+#include <SDL/SDL.h>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+#include "game.h"
+#include "stmtcache.h"
+
+using namespace std;
+
+namespace ll {
+
+/** Games a view lists */
+typedef enum { filter_all, filter_favorite, filter_played, filter_recent } view_filter_t;
+
+/** Number of games the recently played views list */
+#define RECENT_GAMES 30
+
+/** Game fields views are sorted and grouped by */
+typedef enum {
+   key_none, key_name, key_genre, key_manufacturer, key_year, key_count,
+   key_last_played
+} sort_key_t;
+
+/** One field of a view ordering */
+struct sort_field {
+   sort_key_t key;
+   bool descending;
+};
+
+/**
+ * A view as defined in the config file.  Grouped views list a submenu for
+ * each distinct value of the group field, the group field always sorts
+ * first so each submenu is one run of the view.
+ */
+struct view_def {
+   string title;
+   view_filter_t filter;
+   sort_key_t group;
+   vector<sort_field> order;
+};
+
+/**
+ * Reads the view sections of the config file, or the stock favorites, most
+ * played, genres and all views when there are none
+ */
+void read_views(vector<view_def>& views);
+
+/**
+ * Every game in the games table, loaded once at startup.  Each view is an
+ * array of game indexes in the order the view lists them, so changing
+ * views never has to go back to the database.  The views are kept in
+ * order as games are played or marked as favorites.
+ *
+ * Games are stored in one array and their strings in one pool, so loading
+ * a large set takes a handful of allocations instead of several per game.
+ */
+class catalog {
+private:
+   vector<game> _games;
+   vector<char> _strings; // nul terminated strings the games point into
+   vector<const char*> _folded; // lowercase game names for searching
+   vector<const char*> _makers; // lowercase manufacturers for searching
+   vector<const char*> _parents; // rom names of the games clones are of
+   vector<view_def> _defs;
+   vector< vector<Uint32> > _views; // empty for recently played views
+   vector<Uint32> _recent; // ring of the last games played, newest first
+
+   /** Appends the string to the pool and returns its offset, NULL is empty */
+   Uint32 pool(const char* str);
+
+   /** Orders game indexes the way a view lists them */
+   struct view_order {
+      const catalog* c;
+      const view_def* def;
+
+      view_order(const catalog* cat, int v) : c(cat), def(&cat->_defs[v]) { }
+      bool operator()(Uint32 left, Uint32 right) const;
+   };
+
+   /** Compares two games by one field, ascending */
+   int compare(sort_key_t key, Uint32 left, Uint32 right) const;
+
+   /** Returns true if the game belongs in the view */
+   bool member(int view, const game& g) const;
+
+   /** Returns true if the view is kept sorted, rather than in play order */
+   bool sorted(int view) const
+   { return _defs[view].filter != filter_recent; }
+
+   /** Removes the game from every view it is listed in */
+   void detach(Uint32 index);
+
+   /** Inserts the game in order into every view it belongs in */
+   void attach(Uint32 index);
+
+   Uint32 index_of(const game* g) const
+   { return g - &_games[0]; }
+
+public:
+   /**
+    * Loads the games table
+    * @param stmts statements of the open games database
+    * @param show_hidden include hidden and missing games
+    * @param defs views to keep sorted
+    */
+   catalog(stmt_cache& stmts, bool show_hidden, const vector<view_def>& defs);
+
+   /** Returns the approximate number of bytes held by the catalog */
+   size_t bytes() const;
+
+   /** Returns the number of games loaded */
+   Uint32 size() const
+   { return _games.size(); }
+
+   /** Returns the game at index */
+   game* at(Uint32 index)
+   { return &_games[index]; }
+
+   /** Returns the game at index */
+   const game* at(Uint32 index) const
+   { return &_games[index]; }
+
+   /** Returns the lowercase name of the game at index */
+   const char* folded(Uint32 index) const
+   { return _folded[index]; }
+
+   /** Returns the lowercase manufacturer of the game at index */
+   const char* maker(Uint32 index) const
+   { return _makers[index]; }
+
+   /** Returns the number of views */
+   int views() const
+   { return _defs.size(); }
+
+   /** Returns the definition of the view */
+   const view_def& def(int view) const
+   { return _defs[view]; }
+
+   /** Returns the rom name of the game a clone is of, empty if not a clone */
+   const char* parent(const game* g) const
+   { return _parents[index_of(g)]; }
+
+   /** Returns the game indexes listed in the view, in order */
+   const vector<Uint32>& view(int view) const
+   { return sorted(view)? _views[view] : _recent; }
+
+   /** Returns the position of the game in the view, -1 if not listed */
+   int position(int view, const game* g) const;
+
+   /** Returns true if both games are listed in the same submenu of the view */
+   bool same_group(int view, Uint32 left, Uint32 right) const
+   { return compare(_defs[view].group, left, right) == 0; }
+
+   /** Sets title to the submenu the game at index is listed in */
+   void group_title(int view, Uint32 index, string& title) const;
+
+   /** Returns true if playing a game can change what the view lists */
+   bool follows_play(int view) const;
+
+   /** Toggles the favorite status of the game, updating the views */
+   void toggle_favorite(game* g);
+
+   /**
+    * Records a launch of the game, updating the views
+    * @param ok emulator exited successfully, otherwise the game is broken
+    * @param when seconds since the epoch the game was started
+    */
+   void played(game* g, bool ok, long when);
+};
+
+} // end namespace
+
+#endif /*CATALOG_H_*/
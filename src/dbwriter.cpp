@@ -0,0 +1,237 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "dbwriter.h"
+#include "error.h"
+#include "log.h"
+
+// milliseconds to wait for more updates before writing a batch
+#define DB_WRITER_DELAY 2000
+
+using namespace ll;
+using namespace std;
+
+static const char* update_queries[] = {
+   "UPDATE games SET favourite = ?2 WHERE filename = ?1",
+   "UPDATE games SET count = count+1, broken = 0, "
+         "last_played = datetime(?3, 'unixepoch') WHERE filename = ?1",
+   "UPDATE games SET broken = 1 WHERE filename = ?1",
+   "INSERT INTO sessions (filename, exit_code, started, ended, duration) "
+         "VALUES (?1, ?2, ?3, ?4, ?5)"
+};
+
+db_writer::db_writer(const string& file, bool wal) :
+   _db(NULL), _stmts(NULL), _thread(NULL), _quit(false), _flush(false),
+   _writing(false)
+{
+   if (sqlite3_open(file.c_str(), &_db))
+      throw bad_lemon(sqlite3_errmsg(_db));
+
+   // the main connection may be reading while a batch is written
+   sqlite3_busy_timeout(_db, 5000);
+
+   if (wal && sqlite3_exec(_db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL) != SQLITE_OK)
+      log << warn << "db_writer: unable to enable WAL: " << sqlite3_errmsg(_db) << endl;
+
+   // prepare up front so a broken schema shows up at startup
+   _stmts = new stmt_cache(_db);
+   for (int i = 0; i <= session_update; i++) {
+      if (!_stmts->get(update_queries[i]))
+         throw bad_lemon(sqlite3_errmsg(_db));
+   }
+
+   _lock = SDL_CreateMutex();
+   _wake = SDL_CreateCond();
+   _idle = SDL_CreateCond();
+
+   if (!_lock || !_wake || !_idle)
+      throw bad_lemon("db_writer: unable to create mutex");
+
+   _thread = SDL_CreateThread(&db_writer::run, this);
+   if (!_thread)
+      throw bad_lemon("db_writer: unable to create thread");
+}
+
+db_writer::~db_writer()
+{
+   flush();
+
+   SDL_mutexP(_lock);
+   _quit = true;
+   SDL_CondSignal(_wake);
+   SDL_mutexV(_lock);
+
+   SDL_WaitThread(_thread, NULL);
+
+   SDL_DestroyCond(_idle);
+   SDL_DestroyCond(_wake);
+   SDL_DestroyMutex(_lock);
+
+   delete _stmts;
+   sqlite3_close(_db);
+}
+
+void db_writer::favorite(const char* rom, bool favorite)
+{
+   queue(update(favorite_update, rom, favorite));
+}
+
+void db_writer::played(const char* rom, long when)
+{
+   queue(update(played_update, rom, 0, when));
+}
+
+void db_writer::broken(const char* rom)
+{
+   queue(update(broken_update, rom, 1));
+}
+
+void db_writer::session(const char* rom, long started, long ended, long duration, int exit_code)
+{
+   queue(update(session_update, rom, exit_code, started, ended, duration));
+}
+
+void db_writer::queue(const update& u)
+{
+   SDL_mutexP(_lock);
+
+   // only the first update wakes the worker, the rest join its batch
+   if (_queue.empty())
+      SDL_CondSignal(_wake);
+
+   _queue.push_back(u);
+   SDL_mutexV(_lock);
+}
+
+void db_writer::flush()
+{
+   SDL_mutexP(_lock);
+
+   _flush = true;
+   SDL_CondSignal(_wake);
+
+   while (!_queue.empty() || _writing)
+      SDL_CondWait(_idle, _lock);
+
+   _flush = false;
+
+   string error;
+   error.swap(_error);
+
+   // worker is idle, the timings are safe to read
+   unsigned int steps = _stmts->steps();
+   unsigned long prepare_us = _stmts->prepare_us();
+   unsigned long step_us = _stmts->step_us();
+   _stmts->reset_timing();
+
+   SDL_mutexV(_lock);
+
+   if (!error.empty())
+      log << warn << "db_writer: " << error << endl;
+
+   if (steps)
+      log << debug << "db_writer: " << steps << " steps, prepare " << prepare_us
+            << " us, step " << step_us << " us" << endl;
+}
+
+int db_writer::run(void* data)
+{
+   ((db_writer*)data)->work();
+   return 0;
+}
+
+void db_writer::work()
+{
+   SDL_mutexP(_lock);
+
+   while (true) {
+      if (_queue.empty()) {
+         if (_quit) break;
+
+         SDL_CondWait(_wake, _lock);
+         continue;
+      }
+
+      // give more updates a chance to arrive so they share a transaction
+      if (!_flush && !_quit)
+         SDL_CondWaitTimeout(_wake, _lock, DB_WRITER_DELAY);
+
+      vector<update> batch;
+      batch.swap(_queue);
+      _writing = true;
+
+      // write without holding the lock so updates can keep being queued
+      SDL_mutexV(_lock);
+      string error = write(batch);
+      SDL_mutexP(_lock);
+
+      _writing = false;
+      if (_error.empty())
+         _error = error;
+
+      SDL_CondBroadcast(_idle);
+   }
+
+   SDL_mutexV(_lock);
+}
+
+string db_writer::write(const vector<update>& batch)
+{
+   string error;
+
+   if (!exec("BEGIN"))
+      return sqlite3_errmsg(_db);
+
+   for (vector<update>::const_iterator i = batch.begin(); i != batch.end(); i++) {
+      try {
+         sqlite3_stmt* stmt;
+         assert_sqlite(stmt = _stmts->get(update_queries[i->type]));
+         // parameters are numbered the same in every query, each binds
+         // as many as it uses
+         int params = sqlite3_bind_parameter_count(stmt);
+         assert_sqlite(sqlite3_bind_text(stmt, 1, i->rom.c_str(), -1, SQLITE_STATIC) == SQLITE_OK);
+         if (params >= 2)
+            assert_sqlite(sqlite3_bind_int(stmt, 2, i->value) == SQLITE_OK);
+         if (params >= 3)
+            assert_sqlite(sqlite3_bind_int64(stmt, 3, i->started) == SQLITE_OK);
+         if (params >= 4)
+            assert_sqlite(sqlite3_bind_int64(stmt, 4, i->ended) == SQLITE_OK);
+         if (params >= 5)
+            assert_sqlite(sqlite3_bind_int64(stmt, 5, i->duration) == SQLITE_OK);
+         assert_sqlite(_stmts->step(stmt) == SQLITE_DONE);
+      } catch (sqlite_exception ex) {
+         // keep going, one bad row shouldn't lose the rest of the batch
+         if (error.empty())
+            error.assign(sqlite3_errmsg(_db));
+      }
+   }
+
+   if (!exec("COMMIT")) {
+      error.assign(sqlite3_errmsg(_db));
+      exec("ROLLBACK");
+   }
+
+   return error;
+}
+
+bool db_writer::exec(const char* sql)
+{
+   sqlite3_stmt* stmt = _stmts->get(sql);
+   return stmt && _stmts->step(stmt) == SQLITE_DONE;
+}
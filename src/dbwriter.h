@@ -0,0 +1,126 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef DBWRITER_H_
+#define DBWRITER_H_
+
+#include <SDL/SDL.h>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+#include "stmtcache.h"
+
+using namespace std;
+
+namespace ll {
+
+/**
+ * Writes game status changes to the games database on a worker thread, so
+ * the main loop never waits on the disk.  Updates are queued and written
+ * a little later in one transaction, with statements that are prepared
+ * once.  The writer has its own database connection.
+ *
+ * Nothing in the worker logs, errors are kept and logged by flush.
+ */
+class db_writer {
+private:
+   typedef enum {
+      favorite_update, played_update, broken_update, session_update
+   } update_t;
+
+   struct update {
+      update_t type;
+      string rom;
+      int value;
+      long started;  // seconds since the epoch
+      long ended;    // seconds since the epoch
+      long duration; // milliseconds
+
+      update(update_t t, const char* r, int v, long s = 0, long e = 0, long d = 0) :
+         type(t), rom(r), value(v), started(s), ended(e), duration(d) { }
+   };
+
+   sqlite3* _db;
+   stmt_cache* _stmts;
+
+   SDL_Thread* _thread;
+   SDL_mutex* _lock;
+   SDL_cond* _wake;   // signalled when updates are queued or flush is called
+   SDL_cond* _idle;   // signalled when a batch has been written
+
+   bool _quit;
+   bool _flush;       // write the queue now instead of waiting for more
+   bool _writing;     // a batch is being written
+   vector<update> _queue;
+   string _error;     // first error since the last flush
+
+   void queue(const update& u);
+
+   /** Runs a statement that takes no parameters, false on failure */
+   bool exec(const char* sql);
+
+   /** Writes the batch in one transaction, returns an error or "" */
+   string write(const vector<update>& batch);
+
+   static int run(void* data);
+   void work();
+
+public:
+   /**
+    * Opens the database and starts the worker thread
+    * @param file games database
+    * @param wal switch the database to write-ahead logging
+    */
+   db_writer(const string& file, bool wal);
+
+   /** Writes anything still queued and stops the worker */
+   ~db_writer();
+
+   /** Queues a change of the game favorite status */
+   void favorite(const char* rom, bool favorite);
+
+   /**
+    * Queues a successful play of the game, clearing the broken status
+    * @param when seconds since the epoch the game was started
+    */
+   void played(const char* rom, long when);
+
+   /** Queues marking the game as broken */
+   void broken(const char* rom);
+
+   /**
+    * Queues recording a launch of the game
+    * @param started seconds since the epoch the emulator was started
+    * @param ended seconds since the epoch the emulator exited
+    * @param duration milliseconds the emulator ran
+    * @param exit_code emulator exit status
+    */
+   void session(const char* rom, long started, long ended, long duration, int exit_code);
+
+   /**
+    * Waits until every queued update has been written.  Errors the worker
+    * ran into and the time it spent in SQL since the last flush are logged
+    * here.
+    */
+   void flush();
+};
+
+} // end namespace
+
+#endif /*DBWRITER_H_*/
@@ -1,25 +1,39 @@
 #ifndef ERROR_H_
 #define ERROR_H_
 
+#include <string>
 #include "log.h"
 
 namespace ll {
 
 /**
- * Our own exception for errors that occur in the system
+ * Our own exception for errors that occur in the system.  The message is
+ * copied, it often comes from sqlite or a string gone by the time it is
+ * caught.
  */
 class bad_lemon : public exception {
 private:
-  const char* _msg;
+  string _msg;
 
 public:
-  bad_lemon(const char* msg = NULL) : _msg(msg)
-  { log << error << msg << endl; }
+  bad_lemon(const char* msg = NULL) : _msg(msg? msg : "")
+  { log << error << _msg << endl; }
+  
+  virtual ~bad_lemon() throw() { }
   
   virtual const char* what() const throw()
-  { return _msg; }
+  { return _msg.c_str(); }
 };
 
+/** Thrown by assert_sqlite, callers turn it into a bad_lemon */
+struct sqlite_exception { };
+
+template <typename A>
+void assert_sqlite( A assertion )
+{
+   if (!assertion) throw sqlite_exception();
+}
+
 } // end namespace
 
 #endif /*ERROR_H_*/
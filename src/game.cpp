@@ -20,7 +20,6 @@
 
 #include <SDL/SDL_image.h>
 #include "game.h"
-#include "menu.h"
 #include "options.h"
 #include "error.h"
 #include "log.h"
@@ -28,17 +27,25 @@
 using namespace ll;
 using namespace std;
 
-SDL_Surface* game::snapshot()
+bool game::snapshot_file(string& file) const
 {
-   string img(g_opts.get_string(KEY_MAME_SNAP_PATH));
+   file.assign(g_opts.get_string(KEY_MAME_SNAP_PATH));
    
-   size_t pos = img.find("%r");
+   size_t pos = file.find("%r");
    if (pos == string::npos) {
       log << warn << "game::snapshot: snap option missing %r specifier" << endl;
-      return NULL;
+      return false;
    }
    
-   img.replace(pos, 2, rom());
+   file.replace(pos, 2, rom());
+   return true;
+}
+
+SDL_Surface* game::snapshot()
+{
+   string img;
+   if (!snapshot_file(img))
+      return NULL;
    
    log << debug << "game::snapshot: " << img << endl;
 
@@ -53,15 +60,16 @@ SDL_Surface* game::draw(TTF_Font* font, SDL_Color color, SDL_Color hover_color)
 // this method is getting ridiculous. TODO: pass it a 2D array of colors
 SDL_Surface* game::draw(TTF_Font* font, SDL_Color color, SDL_Color hover_color, SDL_Color emphasis_color, SDL_Color emphasis_hover_color, SDL_Color broken_color, SDL_Color broken_hover_color) const
 {
-   bool selected = (this == ((menu*)parent())->selected());
+   // games are listed in several menus and don't belong to any of them,
+   // the caller passes the colors for whether the game is selected
    SDL_Color c;
    
    if (is_broken()) {
-      c = selected ? broken_hover_color : broken_color;
+      c = broken_color;
    } else if (is_favorite()) {
-      c = selected ? emphasis_hover_color : emphasis_color;
+      c = emphasis_color;
    } else {
-      c = selected ? hover_color : color;
+      c = color;
    }
       
    return TTF_RenderText_Blended(font, text(), c);
@@ -28,33 +28,66 @@ using namespace std;
 namespace ll {
 
 /**
- * Game item class
+ * Game item class.  Strings are not copied, they are expected to live in
+ * the catalog string pool for as long as the game does.
  */
 class game : public item {
 private:
-   string _rom;    // rom name
-   string _name;   // game name
-   string _params; // game specific mame parameters
+   const char* _rom;    // rom name
+   const char* _name;   // game name
+   const char* _params; // game specific mame parameters
+   const char* _genre;  // game genre
+   const char* _manufacturer; // game manufacturer
+   int _year;      // year of release, 0 if unknown
+   long _last_played; // seconds since the epoch, 0 if never played
+   int _count;     // number of times the game was played
    bool _favorite; // game is in favorites
    bool _broken;   // game is broken
 
 public:
-   game(const char* rom, const char* name, const char* params, bool favorite, bool broken) :
-      _rom(rom), _name(name), _params(params != NULL? params : ""), _favorite(favorite), _broken(broken) { }
+   game(const char* rom, const char* name, const char* params, const char* genre, const char* manufacturer, int year, long last_played, int count, bool favorite, bool broken) :
+      _rom(rom), _name(name), _params(params != NULL? params : ""), _genre(genre), _manufacturer(manufacturer), _year(year), _last_played(last_played), _count(count), _favorite(favorite), _broken(broken) { }
 
    virtual ~game() { }
    
    /** Returns the rom name */
    const char* rom() const
-   { return _rom.c_str(); }
+   { return _rom; }
 
    /** Returns mame parameters (if any) */
    const char* params() const
-   { return _params.c_str(); }
+   { return _params; }
 
    /** Returns game name as item text */
    const char* text() const
-   { return _name.c_str(); }
+   { return _name; }
+   
+   /** Returns the genre name */
+   const char* genre() const
+   { return _genre; }
+   
+   /** Returns the manufacturer name */
+   const char* manufacturer() const
+   { return _manufacturer; }
+   
+   /** Returns the year of release, 0 if unknown */
+   int year() const
+   { return _year; }
+   
+   /** Returns when the game was last played, 0 if never */
+   long last_played() const
+   { return _last_played; }
+   
+   /** Returns number of times the game was played */
+   const int count() const
+   { return _count; }
+   
+   /**
+    * Increments the play counter
+    * @param when seconds since the epoch the game was started
+    */
+   void played(long when)
+   { _count++; _last_played = when; }
    
    /** Returns game favorite status */
    const bool is_favorite() const
@@ -72,6 +105,16 @@ public:
    void set_broken(bool broken)
    { _broken = broken; }
    
+   /** Broken takes precedence over favorite, same as draw */
+   item_state_t state() const
+   { return _broken? broken_state : _favorite? favorite_state : normal_state; }
+   
+   /**
+    * Resolves the path of the snapshot image for this game
+    * @return false if the snap option is missing the %r specifier
+    */
+   bool snapshot_file(string& file) const;
+   
    SDL_Surface* draw(TTF_Font* font, SDL_Color color, SDL_Color hover_color) const;
    SDL_Surface* draw(TTF_Font* font, SDL_Color color, SDL_Color hover_color, SDL_Color emphasis_color, SDL_Color emphasis_hover_color, SDL_Color broken_color, SDL_Color broken_hover_color) const;
    SDL_Surface* snapshot();
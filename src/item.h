@@ -25,6 +25,9 @@
 
 namespace ll {
 
+/** States that select which colors an item is drawn with */
+typedef enum { normal_state, favorite_state, broken_state } item_state_t;
+
 /**
  * Base class for all drawable items (game, menu, etc)
  */
@@ -57,6 +60,10 @@ public:
    /** Returns textual representation of this item */
    virtual const char* text() const = 0;
    
+   /** Returns the state used to pick the colors this item is drawn with */
+   virtual item_state_t state() const
+   { return normal_state; }
+   
    /**
     * Draws the item and returns the result as a surface
     * @param font font used for text drawing
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "launcher.h"
+#include "error.h"
+#include "log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define LAUNCH_POLL_MS 20    /* how often the watchdog checks the emulator */
+#define LAUNCH_KILL_MS 5000  /* time to exit after SIGTERM before SIGKILL */
+
+using namespace ll;
+using namespace std;
+
+Uint32 ll::wall_ticks()
+{
+   // monotonic, boards without an rtc step the wall clock when ntp syncs
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (Uint32)((unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/** Makes group the foreground process group of the terminal on stdin */
+static void give_terminal(pid_t group)
+{
+   // a background group asking for the terminal is sent SIGTTOU
+   void (*old)(int) = signal(SIGTTOU, SIG_IGN);
+   tcsetpgrp(STDIN_FILENO, group);
+   signal(SIGTTOU, old);
+}
+
+launcher::launcher(const char* command, int timeout) :
+   _timeout(timeout > 0? timeout * 1000 : 0)
+{
+   string word;
+   bool in_word = false, has_rom = false;
+   char quote = 0;
+
+   for (const char* c = command; *c; c++) {
+      if (quote) {
+         if (*c == quote)
+            quote = 0;
+         else
+            word.push_back(*c);
+      } else if (*c == '\'' || *c == '"') {
+         quote = *c;
+         in_word = true;
+      } else if (*c == ' ' || *c == '\t') {
+         if (in_word)
+            _words.push_back(word);
+         word.clear();
+         in_word = false;
+      } else {
+         word.push_back(*c);
+         in_word = true;
+      }
+   }
+
+   if (in_word)
+      _words.push_back(word);
+
+   for (vector<string>::iterator w = _words.begin(); w != _words.end(); w++)
+      has_rom = has_rom || w->find("%r") != string::npos;
+
+   if (quote)
+      throw bad_lemon("mame path has an unterminated quote");
+   if (!has_rom)
+      throw bad_lemon("mame path missing %r specifier");
+}
+
+void launcher::run(const char* rom, launch_result& result) const
+{
+   result.exit_code = -1;
+   result.wall_ms = 0;
+   result.spawned = result.exited = wall_ticks();
+   result.started = false;
+   result.timed_out = false;
+
+   // fill in the rom before forking, the child only execs
+   vector<string> words(_words);
+   vector<char*> argv;
+
+   for (vector<string>::iterator w = words.begin(); w != words.end(); w++) {
+      for (size_t pos = w->find("%r"); pos != string::npos; pos = w->find("%r", pos))
+         w->replace(pos, 2, rom);
+      argv.push_back(&(*w)[0]);
+   }
+   argv.push_back(NULL);
+
+   for (vector<string>::iterator w = words.begin(); w != words.end(); w++)
+      log << debug << "launcher: argv[" << w - words.begin() << "] " << *w << endl;
+
+   // the child writes errno here if exec fails, a successful exec closes it
+   int status_pipe[2];
+   if (pipe(status_pipe) != 0) {
+      log << error << "launcher: pipe: " << strerror(errno) << endl;
+      return;
+   }
+   fcntl(status_pipe[1], F_SETFD, FD_CLOEXEC);
+
+   // a console emulator outside the terminal's foreground group is stopped
+   // by SIGTTOU or SIGTTIN as soon as it touches the tty, so it only gets a
+   // group of its own when it can be handed the terminal, or there is none
+   bool tty = isatty(STDIN_FILENO);
+   bool foreground = tty && tcgetpgrp(STDIN_FILENO) == getpgrp();
+   bool group = foreground || !tty;
+
+   Uint32 start = wall_ticks();
+   pid_t pid = fork();
+
+   if (pid < 0) {
+      log << error << "launcher: fork: " << strerror(errno) << endl;
+      close(status_pipe[0]);
+      close(status_pipe[1]);
+      return;
+   }
+
+   if (pid == 0) {
+      // only async signal safe calls from here on
+      close(status_pipe[0]);
+
+      // own process group, so a wrapper script and the emulator it starts
+      // are stopped together
+      if (group)
+         setpgid(0, 0);
+
+      // also done by the parent, whichever runs first wins the race with
+      // the emulator opening the tty
+      if (foreground) {
+         signal(SIGTTOU, SIG_IGN);
+         tcsetpgrp(STDIN_FILENO, getpid());
+         signal(SIGTTOU, SIG_DFL);
+      }
+
+      execvp(argv[0], &argv[0]);
+
+      int err = errno;
+      if (write(status_pipe[1], &err, sizeof(err)) < 0) { }
+      _exit(127);
+   }
+
+   // also set from this side, the group must exist before it is signalled
+   if (group)
+      setpgid(pid, pid);
+   if (foreground)
+      give_terminal(pid);
+   close(status_pipe[1]);
+
+   int err;
+   ssize_t got;
+   do {
+      got = read(status_pipe[0], &err, sizeof(err));
+   } while (got < 0 && errno == EINTR);
+   close(status_pipe[0]);
+
+   result.started = got != sizeof(err);
+   result.spawned = wall_ticks();
+   result.exit_code = wait(pid, group, result);
+   result.exited = wall_ticks();
+
+   if (foreground)
+      give_terminal(getpgrp());
+   result.wall_ms = result.exited - start;
+
+   if (!result.started) {
+      log << error << "launcher: unable to run " << argv[0] << ": "
+            << strerror(err) << endl;
+      result.exit_code = -1;
+   } else if (result.timed_out) {
+      log << warn << "launcher: " << rom << " stopped at the session limit after "
+            << result.wall_ms / 1000 << " s" << endl;
+   }
+}
+
+int launcher::wait(pid_t pid, bool group, launch_result& result) const
+{
+   pid_t target = group? -pid : pid;
+   Uint32 start = wall_ticks();
+   bool killed = false;
+   int status;
+
+   for (;;) {
+      // without a timeout there is nothing to do but block
+      pid_t done = waitpid(pid, &status, _timeout? WNOHANG : 0);
+
+      if (done == pid)
+         break;
+
+      if (done < 0) {
+         if (errno == EINTR)
+            continue;
+         log << error << "launcher: waitpid: " << strerror(errno) << endl;
+         return -1;
+      }
+
+      Uint32 elapsed = wall_ticks() - start;
+      if (!result.timed_out && elapsed >= _timeout) {
+         kill(target, SIGTERM);
+         result.timed_out = true;
+      } else if (!killed && result.timed_out && elapsed >= _timeout + LAUNCH_KILL_MS) {
+         kill(target, SIGKILL);
+         killed = true;
+      }
+
+      usleep(LAUNCH_POLL_MS * 1000);
+   }
+
+   // whatever the wrapper left running must not outlast the session
+   if (result.timed_out && group)
+      kill(-pid, SIGKILL);
+
+   if (WIFEXITED(status))
+      return WEXITSTATUS(status);
+   if (WIFSIGNALED(status))
+      return 128 + WTERMSIG(status);
+
+   return -1;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef LAUNCHER_H_
+#define LAUNCHER_H_
+
+#include <SDL/SDL.h>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+using namespace std;
+
+namespace ll {
+
+/**
+ * Returns a monotonic millisecond timestamp for timing launches,
+ * SDL_GetTicks starts over when sdl is restarted around the emulator
+ */
+Uint32 wall_ticks();
+
+/** What happened to one run of the emulator */
+struct launch_result {
+   int exit_code;  // emulator exit status, 128 + signal if it was killed
+   Uint32 wall_ms; // from starting the emulator to it being reaped
+   Uint32 spawned; // wall ticks when the emulator was executed
+   Uint32 exited;  // wall ticks when the emulator was reaped
+   bool started;   // the emulator could be executed at all
+   bool timed_out; // stopped at the session limit
+};
+
+/**
+ * Runs the emulator without a shell.  The command template is split into
+ * words once, and each run only fills in the rom name and execs the
+ * emulator directly, in a process group of its own that is given the
+ * terminal when the launcher has it.  The timeout caps how long a session
+ * may last: once it is up the whole group is terminated, first politely
+ * and then with SIGKILL.
+ */
+class launcher {
+private:
+   vector<string> _words; // command template split into words
+   Uint32 _timeout;       // ms a session may last, 0 for no limit
+
+   /**
+    * Reaps the child, stopping it once the timeout is up
+    * @param group the child leads a process group, which is stopped with it
+    */
+   int wait(pid_t pid, bool group, launch_result& result) const;
+
+public:
+   /**
+    * Splits the command template into words.  Words are separated by
+    * spaces, and may be quoted with single or double quotes.
+    * @param command command template, at least one word containing %r
+    * @param timeout seconds a session may last, 0 for no limit
+    */
+   launcher(const char* command, int timeout);
+
+   /**
+    * Runs the emulator for the rom and waits for it to exit
+    * @param rom replaces %r in the command template
+    * @param result receives the exit code and timing of the run
+    */
+   void run(const char* rom, launch_result& result) const;
+};
+
+} // end namespace
+
+#endif /*LAUNCHER_H_*/
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include <config.h>
+#include "launchlog.h"
+#include "launcher.h"
+#include "log.h"
+
+#include <cstdio>
+#include <ctime>
+
+using namespace ll;
+using namespace std;
+
+/** Column names of the time taken to reach each span from the previous */
+static const char* span_names[] = {
+   NULL, "flush", "teardown", "spawn", "run", "rebuild", "db", "first_frame"
+};
+
+launch_log::launch_log(const string& file) :
+   _file(file), _exit_code(-1), _active(false)
+{ }
+
+void launch_log::start(const char* rom)
+{
+   _rom.assign(rom);
+   _exit_code = -1;
+   _active = true;
+
+   for (int s = 0; s < SPAN_COUNT; s++)
+      _marks[s] = 0;
+
+   mark(span_keyup);
+}
+
+void launch_log::mark(span_t span)
+{
+   mark(span, wall_ticks());
+}
+
+void launch_log::mark(span_t span, Uint32 ticks)
+{
+   _marks[span] = ticks;
+}
+
+void launch_log::finish()
+{
+   _active = false;
+
+   // a span that wasn't reached took no time
+   for (int s = 1; s < SPAN_COUNT; s++)
+      if (_marks[s] == 0)
+         _marks[s] = _marks[s-1];
+
+   log << info << "launch_log: " << _rom << " exited with " << _exit_code;
+   for (int s = 1; s < SPAN_COUNT; s++)
+      log << ", " << span_names[s] << ' ' << _marks[s] - _marks[s-1] << " ms";
+   log << ", back in " << _marks[SPAN_COUNT-1] - _marks[span_exited] << " ms" << endl;
+
+   FILE* out = fopen(_file.c_str(), "a");
+   if (!out) {
+      log << warn << "launch_log: unable to write " << _file << endl;
+      return;
+   }
+
+   // header goes at the top of a new file
+   fseek(out, 0, SEEK_END);
+   if (ftell(out) == 0) {
+      fputs("time,version,rom,exit_code", out);
+      for (int s = 1; s < SPAN_COUNT; s++)
+         fprintf(out, ",%s_ms", span_names[s]);
+      fputs("\n", out);
+   }
+
+   fprintf(out, "%ld,%s,%s,%d", (long)time(NULL), PACKAGE_VERSION,
+         _rom.c_str(), _exit_code);
+   for (int s = 1; s < SPAN_COUNT; s++)
+      fprintf(out, ",%u", (unsigned)(_marks[s] - _marks[s-1]));
+   fputs("\n", out);
+
+   if (fclose(out) != 0)
+      log << warn << "launch_log: unable to write " << _file << endl;
+}
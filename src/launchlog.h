@@ -0,0 +1,84 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef LAUNCHLOG_H_
+#define LAUNCHLOG_H_
+
+#include <SDL/SDL.h>
+#include <string>
+
+using namespace std;
+
+namespace ll {
+
+/** Points in a launch that are timed, in the order they happen */
+typedef enum {
+   span_keyup,       // game selected to run
+   span_flushed,     // queued database writes are on disk
+   span_torn_down,   // screen is gone
+   span_spawned,     // emulator executed
+   span_exited,      // emulator reaped
+   span_rebuilt,     // screen is back
+   span_db,          // play count and status queued for writing
+   span_first_frame, // menu drawn again
+   SPAN_COUNT
+} span_t;
+
+/**
+ * Times where launches spend their time, from the key that started the
+ * game to the menu being drawn again.  Each launch is logged and appended
+ * to a csv file along with the rom and exit code, so slow games and
+ * regressions between versions can be found later.
+ */
+class launch_log {
+private:
+   const string _file; // csv file launches are appended to
+   string _rom;
+   int _exit_code;
+   bool _active;       // a launch is being timed
+   Uint32 _marks[SPAN_COUNT];
+
+public:
+   /** @param file csv file to append launches to */
+   launch_log(const string& file);
+
+   /** Starts timing a launch of the rom, marking span_keyup */
+   void start(const char* rom);
+
+   /** Marks the span as reached now */
+   void mark(span_t span);
+
+   /** Marks the span as reached at the given wall ticks */
+   void mark(span_t span, Uint32 ticks);
+
+   /** Sets the exit code of the emulator */
+   void exit_code(int code)
+   { _exit_code = code; }
+
+   /** Returns true between start and finish */
+   bool active() const
+   { return _active; }
+
+   /** Logs the launch and appends it to the csv file */
+   void finish();
+};
+
+} // end namespace
+
+#endif /*LAUNCHLOG_H_*/
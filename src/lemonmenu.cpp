@@ -23,6 +23,7 @@
 #include "error.h"
 
 #include <cstring>
+#include <ctime>
 #include <sqlite3.h>
 #include <sstream>
 #include <algorithm>
@@ -31,15 +32,50 @@
 
 #define UPDATE_SNAP_EVENT 1
 #define JOYSTICK_REPEAT_EVENT 2
+#define SNAP_LOADED_EVENT 3
+#define FRAME_EVENT 4
+
+// number of frames to collect before logging frame time statistics
+#define FRAME_STATS_SAMPLES 120
+
+// searches with fewer matches than this are topped up with close matches
+#define SEARCH_CLOSE_MATCHES 20
+
+// milliseconds finding close matches should take at most
+#define SEARCH_CLOSE_MS 5
 
 using namespace ll;
 using namespace std;
 
+/**
+ * Schema changes applied to games.db at startup, in order.  The n-th entry
+ * upgrades the database to schema version n+1.  Only ever append to this.
+ */
+static const char* migrations[] = {
+   // games are looked up by rom name when written (databases made by
+   // lemontool don't key on it) and loaded in name order skipping hidden
+   // and missing games
+   "CREATE INDEX IF NOT EXISTS games_filename ON games (filename);"
+   "CREATE INDEX IF NOT EXISTS games_listed ON games (hide, missing, name);",
+   
+   // every launch is recorded with when it started and ended
+   "CREATE TABLE IF NOT EXISTS sessions ("
+   "   filename TEXT NOT NULL, exit_code INTEGER NOT NULL,"
+   "   started INTEGER NOT NULL, ended INTEGER NOT NULL,"
+   "   duration INTEGER NOT NULL);",
+   NULL
+};
+
 /**
  * Function executed after a timeout for finding snapshot images
  */
 static Uint32 snap_timer_callback(Uint32 interval, void *param);
 
+/**
+ * Function executed when the next frame is due in frame paced mode
+ */
+static Uint32 frame_timer_callback(Uint32 interval, void *param);
+
 /**
  * Function executed to repeat joystick input
  */
@@ -50,14 +86,6 @@ static Uint32 joystick_repeat_timer_callback(Uint32 interval, void *param);
  */
 int launch_game(void* data);
 
-struct sqlite_exception { };
-
-template <typename A>
-void assert_sqlite( A assertion )
-{
-   if (!assertion) throw sqlite_exception();
-}
-
 /**
  * Compares the text property of two item pointers and returns true if the left
  * is less than the right.
@@ -66,8 +94,13 @@ bool cmp_item(item* left, item* right)
 { return strcmp(left->text(), right->text()) < 0; }
 
 lemon_menu::lemon_menu(lemonui* ui) :
-   _db(NULL), _top(NULL), _current(NULL), _show_hidden(false),
+   _db(NULL), _stmts(NULL), _writer(NULL), _launcher(NULL), _catalog(NULL), _trigrams(NULL), _top(NULL), _current(NULL),
+   _search(NULL), _search_return(NULL), _show_hidden(false), _redraw(false),
+   _last_frame(0), _frame_timer(0), _launch_log(NULL),
+   _launch_mode(g_opts.get_int(KEY_LAUNCH_MODE)),
    _snap_timer(0), _snap_delay(g_opts.get_int(KEY_SNAPSHOT_DELAY)),
+   _thumbs(NULL), _snap_loader(NULL), _rom_warmer(NULL), _snap_prefetch(g_opts.get_int(KEY_SNAPSHOT_PREFETCH)),
+   _snap_cache(g_opts.get_int(KEY_SNAPSHOT_CACHE) * 1024),
    _joystick_repeat_delay(250), _joystick_repeat_period(50)
 {
    // locate games.db file in confdir
@@ -77,8 +110,49 @@ lemon_menu::lemon_menu(lemonui* ui) :
    if (sqlite3_open(db_file.c_str(), &_db))
       throw bad_lemon(sqlite3_errmsg(_db));
    
+   int fps = g_opts.get_int(KEY_FRAME_RATE);
+   _frame_period = fps > 0? 1000 / fps : 0;
+   
+   _stmts = new stmt_cache(_db);
+   migrate();
+   
+   vector<view_def> views;
+   read_views(views);
+   
+   _views.assign(views.size(), (menu*)NULL);
+   _stale.assign(views.size(), true);
+   
+   _catalog = new catalog(*_stmts, _show_hidden, views);
+   log_sql("catalog");
+   
+   string trigram_file("games.trigrams");
+   g_opts.resolve(trigram_file);
+   _trigrams = new trigram_index(*_catalog, trigram_file);
+   
+   _writer = new db_writer(db_file, g_opts.get_bool(KEY_DATABASE_WAL));
+   _launcher = new launcher(g_opts.get_string(KEY_MAME_PATH),
+         g_opts.get_int(KEY_MAME_TIMEOUT));
+   
+   string launch_file("launches.csv");
+   g_opts.resolve(launch_file);
+   _launch_log = new launch_log(launch_file);
+   
    _layout = ui;
-   change_view(favorite);
+   change_view(0);
+   
+   if (g_opts.get_bool(KEY_THUMBNAILS)) {
+      string thumb_dir("thumbs");
+      g_opts.resolve(thumb_dir);
+      
+      const SDL_Rect& fit = _layout->snap_rect();
+      _thumbs = new thumb_cache(thumb_dir, fit.w, fit.h, _layout->snap_alpha());
+   }
+   
+   _snap_loader = new snap_loader(_layout, _thumbs, SNAP_LOADED_EVENT);
+   
+   string rom_path(g_opts.get_string(KEY_ROM_PATH));
+   if (!rom_path.empty())
+      _rom_warmer = new rom_warmer(rom_path, g_opts.get_int(KEY_ROM_PRELOAD) * 1024);
    
    // axis, direction, delay, period, timer
    _joystick_repeat_config_x = (joystick_repeat_config) {
@@ -95,15 +169,144 @@ lemon_menu::lemon_menu(lemonui* ui) :
 
 lemon_menu::~lemon_menu()
 {
-   delete _top; // delete top menu will propigate to children
+   delete _rom_warmer;
+   delete _snap_loader;
+   delete _thumbs;
+   
+   delete _search;
+   
+   // deleting the view menus propigates to children, games are owned by
+   // the catalog
+   for (size_t v = 0; v < _views.size(); v++)
+      delete _views[v];
+   delete _trigrams;
+   delete _catalog;
+   delete _launcher;
+   delete _launch_log;
+   delete _writer; // writes anything still queued
+   delete _stmts;
    
    if (_db)
       sqlite3_close(_db);
 }
 
+void lemon_menu::migrate()
+{
+   int version = 0;
+   
+   try {
+      assert_sqlite(sqlite3_exec(_db, "CREATE TABLE IF NOT EXISTS schema_version "
+            "(version INTEGER NOT NULL)", NULL, NULL, NULL) == SQLITE_OK);
+      
+      sqlite3_stmt* stmt;
+      assert_sqlite(stmt = _stmts->get("SELECT max(version) FROM schema_version"));
+      assert_sqlite(_stmts->step(stmt) == SQLITE_ROW);
+      version = sqlite3_column_int(stmt, 0); // NULL when empty, reads as 0
+      sqlite3_reset(stmt);
+   } catch (sqlite_exception ex) {
+      throw bad_lemon(sqlite3_errmsg(_db));
+   }
+   
+   int latest = 0;
+   while (migrations[latest] != NULL)
+      latest++;
+   
+   // written by a newer build, its changes only add to the schema so this
+   // one can still run against it
+   if (version > latest) {
+      log << warn << "migrate: games.db has schema version " << version
+            << ", newer than " << latest << ", leaving it as it is" << endl;
+      return;
+   }
+   
+   for (int i = version; i < latest; i++) {
+      log << info << "migrate: upgrading games.db to schema version " << i+1 << endl;
+      
+      // each migration is applied completely or not at all
+      try {
+         assert_sqlite(sqlite3_exec(_db, "BEGIN", NULL, NULL, NULL) == SQLITE_OK);
+         assert_sqlite(sqlite3_exec(_db, migrations[i], NULL, NULL, NULL) == SQLITE_OK);
+         
+         sqlite3_stmt* stmt;
+         assert_sqlite(stmt = _stmts->get("INSERT INTO schema_version VALUES (?)"));
+         assert_sqlite(sqlite3_bind_int(stmt, 1, i+1) == SQLITE_OK);
+         assert_sqlite(_stmts->step(stmt) == SQLITE_DONE);
+         
+         assert_sqlite(sqlite3_exec(_db, "COMMIT", NULL, NULL, NULL) == SQLITE_OK);
+      } catch (sqlite_exception ex) {
+         // the rollback replaces the message
+         string errmsg(sqlite3_errmsg(_db));
+         sqlite3_exec(_db, "ROLLBACK", NULL, NULL, NULL);
+         throw bad_lemon(errmsg.c_str());
+      }
+   }
+   
+   log_sql("migrate");
+}
+
+void lemon_menu::log_sql(const char* what)
+{
+   ll::log << debug << what << ": " << _stmts->prepares() << " prepared in "
+         << _stmts->prepare_us() << " us, " << _stmts->steps() << " steps in "
+         << _stmts->step_us() << " us" << endl;
+   
+   _stmts->reset_timing();
+}
+
 void lemon_menu::render()
 {
+   Uint32 start = SDL_GetTicks();
+   
    _layout->render(_current);  // pass off rendering to layout class
+   _redraw = false;
+   _last_frame = start;
+   
+   bool launched = _launch_log->active();
+   if (launched)
+      _launch_log->mark(span_first_frame);
+   
+   if (ll::log.level() >= debug) {
+      _frame_times.push_back(SDL_GetTicks() - start);
+      
+      if (_frame_times.size() >= FRAME_STATS_SAMPLES)
+         log_frame_stats();
+   }
+   
+   // appending to the log hits the disk, keep it out of the frame time
+   if (launched)
+      _launch_log->finish();
+}
+
+void lemon_menu::schedule_render()
+{
+   // unpaced, draw as soon as the batch of events is handled
+   if (_frame_period == 0) {
+      render();
+      return;
+   }
+   
+   // frame already scheduled, it will pick up whatever changed since
+   if (_frame_timer)
+      return;
+   
+   Uint32 elapsed = SDL_GetTicks() - _last_frame;
+   if (elapsed >= _frame_period)
+      render();
+   else
+      _frame_timer = SDL_AddTimer(_frame_period - elapsed, frame_timer_callback, NULL);
+}
+
+void lemon_menu::log_frame_stats()
+{
+   vector<Uint32> times(_frame_times);
+   sort(times.begin(), times.end());
+   
+   size_t n = times.size();
+   ll::log << debug << "render: " << n << " frames, p50 " << times[n / 2]
+         << " ms, p99 " << times[(n * 99) / 100] << " ms, max "
+         << times[n - 1] << " ms" << endl;
+   
+   _frame_times.clear();
 }
 
 void lemon_menu::main_loop()
@@ -121,6 +324,7 @@ void lemon_menu::main_loop()
    const int select_key = g_opts.get_int(KEY_KEYCODE_SELECT);
    const int back_key = g_opts.get_int(KEY_KEYCODE_BACK);
    const int toggle_favorite_key = g_opts.get_int(KEY_KEYCODE_FAVORITE);
+   const int search_key = g_opts.get_int(KEY_KEYCODE_SEARCH);
    const int alphamod = g_opts.get_int(KEY_KEYCODE_ALPHAMOD);
    const int viewmod = g_opts.get_int(KEY_KEYCODE_VIEWMOD);
    const int x_axis = g_opts.get_int(JOY_AXIS_LEFT_RIGHT);
@@ -144,136 +348,167 @@ void lemon_menu::main_loop()
       SDL_Event event;
       SDL_WaitEvent(&event);
 
-      SDLKey key = event.key.keysym.sym;
-      SDLMod mod = event.key.keysym.mod;
-
-      switch (event.type) {
-      case SDL_QUIT:
-         _running = false;
+      // handle everything that queued up while the last frame was being
+      // drawn before drawing again, so input never lags behind rendering
+      do {
+         SDLKey key = event.key.keysym.sym;
+         SDLMod mod = event.key.keysym.mod;
 
-         break;
-      case SDL_KEYUP:
-         if (key == exit_key) {
+         switch (event.type) {
+         case SDL_QUIT:
             _running = false;
-         } else if (key == select_key) {
-            handle_activate();
-         } else if (key == back_key) {
-            handle_up_menu();
-         } else if (key == toggle_favorite_key) {
-            handle_toggle_favorite();
-         }
 
-         break;
-      case SDL_KEYDOWN:
-         if (key == up_key) {
-            handle_up();
-         } else if (key == down_key) {
-            handle_down();
-         } else if (key == pgup_key) {
-            if (mod & alphamod)
-               handle_alphaup();
-            else if (mod & viewmod)
-               handle_viewdown();
-            else
-               handle_pgup();
-         } else if (key == pgdown_key) {
-            if (mod & alphamod)
-               handle_alphadown();
-            else if (mod & viewmod)
-               handle_viewup();
-            else
-               handle_pgdown();
-         }
+            break;
+         case SDL_KEYUP:
+            // typing goes to the search while there is one
+            if (_search) {
+               handle_search_key(key);
+            } else if (key == search_key) {
+               start_search();
+            } else if (key == exit_key) {
+               _running = false;
+            } else if (key == select_key) {
+               handle_activate();
+            } else if (key == back_key) {
+               handle_up_menu();
+            } else if (key == toggle_favorite_key) {
+               handle_toggle_favorite();
+            }
+
+            break;
+         case SDL_KEYDOWN:
+            // characters are typed into the search as the keyboard layout
+            // has them, sdl only translates keys when they go down
+            if (_search && key != exit_key && key != select_key && key != back_key &&
+                  event.key.keysym.unicode >= ' ' && event.key.keysym.unicode < 0x7f) {
+               handle_search_text((char)event.key.keysym.unicode);
+               break;
+            }
+            
+            if (key == up_key) {
+               handle_up();
+            } else if (key == down_key) {
+               handle_down();
+            } else if (key == pgup_key) {
+               if (mod & alphamod)
+                  handle_alphaup();
+               else if (mod & viewmod)
+                  handle_viewdown();
+               else
+                  handle_pgup();
+            } else if (key == pgdown_key) {
+               if (mod & alphamod)
+                  handle_alphadown();
+               else if (mod & viewmod)
+                  handle_viewup();
+               else
+                  handle_pgdown();
+            }
 
-         break;
-      case SDL_JOYAXISMOTION:
-         // correct value for Xin-Mo Dual Arcade -2..+1 glitch
-         int corrected, reverse;
-         if (event.jaxis.axis == x_axis_num)
-            reverse = x_axis_reverse;
-         else if (event.jaxis.axis == y_axis_num)
-            reverse = y_axis_reverse;
+            break;
+         case SDL_JOYAXISMOTION:
+            // correct value for Xin-Mo Dual Arcade -2..+1 glitch
+            int corrected, reverse;
+            if (event.jaxis.axis == x_axis_num)
+               reverse = x_axis_reverse;
+            else if (event.jaxis.axis == y_axis_num)
+               reverse = y_axis_reverse;
          
-         if( event.jaxis.value > 16383 )
-            corrected = reverse * 32767;
-         else if( event.jaxis.value < -16384 )
-            corrected = -reverse * 32768;
-         else
-            corrected = 0;
+            if( event.jaxis.value > 16383 )
+               corrected = reverse * 32767;
+            else if( event.jaxis.value < -16384 )
+               corrected = -reverse * 32768;
+            else
+               corrected = 0;
          
-         if (event.jaxis.axis == y_axis_num) {
-            if (corrected > hyst_out && prev_joy_y != 1) {
-               // joystick moved up
-               prev_joy_y = 1;
-               handle_up();
+            if (event.jaxis.axis == y_axis_num) {
+               if (corrected > hyst_out && prev_joy_y != 1) {
+                  // joystick moved up
+                  prev_joy_y = 1;
+                  handle_up();
 
-               _joystick_repeat_config_y.direction = 1;
-               start_joystick_repeat_timer(&_joystick_repeat_config_y, false);
-            } else if (corrected < -hyst_out && prev_joy_y != -1) {
-               // joystick moved down
-               prev_joy_y = -1;
-               handle_down();
+                  _joystick_repeat_config_y.direction = 1;
+                  start_joystick_repeat_timer(&_joystick_repeat_config_y, false);
+               } else if (corrected < -hyst_out && prev_joy_y != -1) {
+                  // joystick moved down
+                  prev_joy_y = -1;
+                  handle_down();
 
-               _joystick_repeat_config_y.direction = -1;
-               start_joystick_repeat_timer(&_joystick_repeat_config_y, false);
-            } else if (corrected > -hyst_in && corrected < hyst_in) {
-               // joystick moved back to the center (vertically)
-               prev_joy_y = 0;
-               stop_joystick_repeat_timer(&_joystick_repeat_config_y);
-            }
-         } else if (event.jaxis.axis == x_axis_num) {
-            if (corrected > hyst_out && prev_joy_x != 1) {
-               // joystick moved to the left
-               prev_joy_x = 1;
-               handle_viewup();
-
-               _joystick_repeat_config_x.direction = 1;
-               start_joystick_repeat_timer(&_joystick_repeat_config_x, false);
-            } else if (corrected < -hyst_out && prev_joy_x != -1) {
-               // joystick moved to the right
-               prev_joy_x = -1;
-               handle_viewdown();
-
-               _joystick_repeat_config_x.direction = -1;
-               start_joystick_repeat_timer(&_joystick_repeat_config_x, false);
-            } else if (corrected > -hyst_in && corrected < hyst_in) {
-               // joystick moved back to the center (horizontally)
-               prev_joy_x = 0;
-               stop_joystick_repeat_timer(&_joystick_repeat_config_x);
-            }
-         }
-         break;
-      case SDL_JOYBUTTONUP:
-         log << info << event.jbutton.button + 1 << endl;
-         if (event.jbutton.button + 1 == joy_select_button) {
-            handle_activate();
-         } else if (event.jbutton.button + 1 == joy_back_button) {
-            handle_up_menu();
-         }
-         break;
-      case SDL_USEREVENT:
-         if (event.user.code == UPDATE_SNAP_EVENT) {
-            update_snap();
-         } else if (event.user.code == JOYSTICK_REPEAT_EVENT) {
-            joystick_repeat_config *config = (joystick_repeat_config *) event.user.data1;
-            // log << info << "repeat: " << config->axis << " " << config->direction << endl;
-            if (config->axis == x_axis_num) {
-               if (config->direction == 1)
+                  _joystick_repeat_config_y.direction = -1;
+                  start_joystick_repeat_timer(&_joystick_repeat_config_y, false);
+               } else if (corrected > -hyst_in && corrected < hyst_in) {
+                  // joystick moved back to the center (vertically)
+                  prev_joy_y = 0;
+                  stop_joystick_repeat_timer(&_joystick_repeat_config_y);
+               }
+            } else if (event.jaxis.axis == x_axis_num) {
+               if (corrected > hyst_out && prev_joy_x != 1) {
+                  // joystick moved to the left
+                  prev_joy_x = 1;
                   handle_viewup();
-               else if (config->direction == -1)
+
+                  _joystick_repeat_config_x.direction = 1;
+                  start_joystick_repeat_timer(&_joystick_repeat_config_x, false);
+               } else if (corrected < -hyst_out && prev_joy_x != -1) {
+                  // joystick moved to the right
+                  prev_joy_x = -1;
                   handle_viewdown();
-               start_joystick_repeat_timer(&_joystick_repeat_config_x, true);
-            } else if (config->axis == y_axis_num) {
-               if (config->direction == 1)
-                  handle_up();
-               else if (config->direction == -1)
-                  handle_down();
-               start_joystick_repeat_timer(&_joystick_repeat_config_y, true);
+
+                  _joystick_repeat_config_x.direction = -1;
+                  start_joystick_repeat_timer(&_joystick_repeat_config_x, false);
+               } else if (corrected > -hyst_in && corrected < hyst_in) {
+                  // joystick moved back to the center (horizontally)
+                  prev_joy_x = 0;
+                  stop_joystick_repeat_timer(&_joystick_repeat_config_x);
+               }
+            }
+            break;
+         case SDL_JOYBUTTONUP:
+            log << info << event.jbutton.button + 1 << endl;
+            if (event.jbutton.button + 1 == joy_select_button) {
+               handle_activate();
+            } else if (event.jbutton.button + 1 == joy_back_button) {
+               handle_up_menu();
+            }
+            break;
+         case SDL_USEREVENT:
+            if (event.user.code == UPDATE_SNAP_EVENT) {
+               update_snap();
+            } else if (event.user.code == SNAP_LOADED_EVENT) {
+               handle_snap_loaded((snap_result*)event.user.data1);
+            } else if (event.user.code == FRAME_EVENT) {
+               // frame is due, drawn once the rest of the batch is handled
+               _frame_timer = 0;
+            } else if (event.user.code == JOYSTICK_REPEAT_EVENT) {
+               joystick_repeat_config *config = (joystick_repeat_config *) event.user.data1;
+               // log << info << "repeat: " << config->axis << " " << config->direction << endl;
+
+               // stick was centered after this repeat was queued, acting on
+               // it would overshoot and restart the repeat timer
+               if (config->direction == 0)
+                  break;
+
+               if (config->axis == x_axis_num) {
+                  if (config->direction == 1)
+                     handle_viewup();
+                  else if (config->direction == -1)
+                     handle_viewdown();
+                  start_joystick_repeat_timer(&_joystick_repeat_config_x, true);
+               } else if (config->axis == y_axis_num) {
+                  if (config->direction == 1)
+                     handle_up();
+                  else if (config->direction == -1)
+                     handle_down();
+                  start_joystick_repeat_timer(&_joystick_repeat_config_y, true);
+               }
             }
+
+            break;
          }
+      } while (_running && SDL_PollEvent(&event));
 
-         break;
-      }
+      if (_redraw)
+         schedule_render();
    }
 
    reset_snap_timer();
@@ -284,7 +519,7 @@ void lemon_menu::handle_up()
    // ignore event if already at the top of menu
    if (_current->select_previous()) {
       reset_snap_timer();
-      render();
+      _redraw = true;
    }
 }
 
@@ -293,7 +528,7 @@ void lemon_menu::handle_down()
    // ignore event if already at the bottom of menu
    if (_current->select_next()) {
       reset_snap_timer();
-      render();
+      _redraw = true;
    }
 }
 
@@ -302,7 +537,7 @@ void lemon_menu::handle_pgup()
    // ignore event if already at the top of menu
    if (_current->select_previous(_layout->page_size())) {
       reset_snap_timer();
-      render();
+      _redraw = true;
    }
 }
 
@@ -311,7 +546,7 @@ void lemon_menu::handle_pgdown()
    // ignore event if already at the bottom of menu
    if (_current->select_next(_layout->page_size())) {
       reset_snap_timer();
-      render();
+      _redraw = true;
    }
 }
 
@@ -320,7 +555,7 @@ void lemon_menu::handle_alphaup()
    // up in the alphabet is the previous letter
    if (_current->select_previous_alpha()) {
       reset_snap_timer();
-      render();
+      _redraw = true;
    }
 }
 
@@ -329,25 +564,25 @@ void lemon_menu::handle_alphadown()
    // down in the alphabet is the next letter
    if (_current->select_next_alpha()) {
       reset_snap_timer();
-      render();
+      _redraw = true;
    }
 }
 
 void lemon_menu::handle_viewup()
 {
-   if (_view != all) {
-      change_view((view_t)(_view+1));
+   if (_view + 1 < (int)_views.size()) {
+      change_view(_view + 1);
       reset_snap_timer();
-      render();
+      _redraw = true;
    }
 }
 
 void lemon_menu::handle_viewdown()
 {
-   if (_view != favorite) {
-      change_view((view_t)(_view-1));
+   if (_view > 0) {
+      change_view(_view - 1);
       reset_snap_timer();
-      render();
+      _redraw = true;
    }
 }
 
@@ -366,62 +601,56 @@ void lemon_menu::handle_activate()
 
 void lemon_menu::handle_toggle_favorite()
 {
+   // ignore when this isn't any children, the favorites may be empty
+   if (!_current->has_children()) return;
+   
    item* item = _current->selected();
    if (typeid(game) != typeid(*item))
       return;
    
    game* g = (game*)item;
-   g->toggle_favorite();
-
-   ll::log << debug << "handle_toggle_favorite: " << g->text() << ": " << g->is_favorite() << endl;
-
-   // create query to toggle game favorite status
-   string query("UPDATE games SET favourite = ? WHERE filename = ?");
-   ll::log << debug << query << endl;
    
-   sqlite3_stmt *stmt;
-   try {
-      assert_sqlite(sqlite3_prepare_v2(_db, query.c_str(), -1, &stmt, NULL) == SQLITE_OK);
-      assert_sqlite(sqlite3_bind_int(stmt, 1, g->is_favorite()) == SQLITE_OK);
-      assert_sqlite(sqlite3_bind_text(stmt, 2, g->rom(), -1, SQLITE_TRANSIENT) == SQLITE_OK);
-      assert_sqlite(sqlite3_step(stmt) == SQLITE_DONE);
-   } catch (sqlite_exception ex) {
-         const char *errmsg = sqlite3_errmsg(_db);
-         sqlite3_finalize(stmt);
-         throw bad_lemon(errmsg);
+   // favorites menus are never grouped and list games in catalog view
+   // order, so the game can be moved in or out of them without rebuilding
+   // the menu
+   vector<int> favorites;
+   for (int v = 0; v < _catalog->views(); v++) {
+      if (_catalog->def(v).filter != filter_favorite || _stale[v])
+         continue;
+      
+      favorites.push_back(v);
+      if (g->is_favorite())
+         _views[v]->remove_child(_catalog->position(v, g));
+   }
+   
+   _catalog->toggle_favorite(g);
+   
+   bool shown = false;
+   for (vector<int>::iterator v = favorites.begin(); v != favorites.end(); v++) {
+      if (g->is_favorite())
+         _views[*v]->insert_child(_catalog->position(*v, g), g, false);
+      shown = shown || _views[*v] == _current;
    }
 
-   sqlite3_finalize(stmt);
+   ll::log << debug << "handle_toggle_favorite: " << g->text() << ": " << g->is_favorite() << endl;
 
-   // force upate if we're in the favorites menu
-   if(_view == favorite) {
-      // get index of currently selected item
-      int selected = _current->selected_index();
-      
-      change_view(_view);
-      
-      // restore selection
-      _current->select_index(selected);
+   _writer->favorite(g->rom(), g->is_favorite());
 
+   // the next favorite takes the place of the one removed from the list
+   if (shown) {
+      _layout->invalidate();
       reset_snap_timer();
    }
    
-   render();
+   _redraw = true;
 }
 
 void lemon_menu::handle_run()
 {
    game* g = (game*)_current->selected();
+   _launch_log->start(g->rom());
    log << info << "handle_run: launching game " << g->text() << endl;
    
-   string cmd(g_opts.get_string(KEY_MAME_PATH));
-   size_t pos = cmd.find("%r");
-   if (pos == string::npos)
-      throw bad_lemon("mame path missing %r specifier");
-
-   cmd.replace(pos, 2, g->rom());
-   ll::log << debug << "handle_run: " << cmd << endl;
-
    // This bit of code here has been a big pain.  On linux in full screen (X11)
    // lemon launcher has to be minimized before launching mame or else things
    // tend to lock up.  On windows lemon launcher is automagically minimized
@@ -431,50 +660,82 @@ void lemon_menu::handle_run()
    // That said, I think I have it sorted.  Simply destroying lemon launchers
    // screen and then re-creating it after mame exits seems to get rid of the
    // irregularities.  Even on Windows!
+   //
+   // Shutting down only the video and keeping the timer and joysticks
+   // going is quicker still, where the platform lets us.
+
+   // nothing may be pushed to the event queue while the screen is gone
+   _snap_loader->cancel();
+   
+   // timers that fire while the emulator runs would act on the menu once
+   // it is back, and don't survive sdl being restarted anyway
+   if (_snap_timer)
+      SDL_RemoveTimer(_snap_timer);
+   if (_frame_timer)
+      SDL_RemoveTimer(_frame_timer);
+   _snap_timer = _frame_timer = 0;
+   stop_joystick_repeat_timer(&_joystick_repeat_config_x);
+   stop_joystick_repeat_timer(&_joystick_repeat_config_y);
+   
+   // the emulator may take the machine down with it, get the disk in order
+   _writer->flush();
+   _launch_log->mark(span_flushed);
 
    // destroy buffers and screen
-   _layout->destroy_screen();
+   if (_launch_mode == LAUNCH_VIDEO)
+      _layout->release_screen();
+   else
+      _layout->destroy_screen();
+   _launch_log->mark(span_torn_down);
    
    // launch mame and hope for the best
-   int exit_code = system(cmd.c_str());
+   launch_result result;
+   time_t started = time(NULL);
+   _launcher->run(g->rom(), result);
+   time_t ended = time(NULL);
+   _launch_log->mark(span_spawned, result.spawned);
+   _launch_log->mark(span_exited, result.exited);
+   _launch_log->exit_code(result.exit_code);
    
-   // create screen and render
-   _layout->setup_screen();
-   render();
+   // create screen, main loop renders once the game is accounted for,
+   // snapshots converted for a screen in another format would blit slowly
+   if (_layout->setup_screen())
+      _snap_cache.clear();
+   _redraw = true;
+   
+   // input meant for the emulator, like the key that quit it, may still
+   // arrive once the screen is back
+   SDL_Event evt;
+   SDL_PumpEvents();
+   while (SDL_PeepEvents(&evt, 1, SDL_GETEVENT, SDL_EVENTMASK(SDL_KEYDOWN) |
+         SDL_EVENTMASK(SDL_KEYUP) | SDL_EVENTMASK(SDL_JOYAXISMOTION) |
+         SDL_EVENTMASK(SDL_JOYBUTTONDOWN) | SDL_EVENTMASK(SDL_JOYBUTTONUP)) > 0);
+   _launch_log->mark(span_rebuilt);
    
    // increment the games play counter if emulator returned success
    // mark the game as broken otherwise
-   string query;
-   sqlite3_stmt *stmt;
-
-   g->set_broken(exit_code != 0);
-   if (g->is_broken()) {
-      // mark game as broken
-      query = string("UPDATE games SET broken = 1 WHERE filename = ?");
-   } else {
-      // update number of times game has been played
-      query = string("UPDATE games SET count = count+1, broken = 0 WHERE filename = ?");
-   }
+   _catalog->played(g, result.exit_code == 0, started);
+   for (int v = 0; v < _catalog->views(); v++)
+      if (_catalog->follows_play(v))
+         _stale[v] = true;
    
-   try {
-      assert_sqlite(sqlite3_prepare_v2(_db, query.c_str(), -1, &stmt, NULL) == SQLITE_OK);
-      assert_sqlite(sqlite3_bind_text(stmt, 1, g->rom(), -1, SQLITE_TRANSIENT) == SQLITE_OK);
-      assert_sqlite(sqlite3_step(stmt) == SQLITE_DONE);
-   } catch (sqlite_exception ex) {
-      const char *errmsg = sqlite3_errmsg(_db);
-      sqlite3_finalize(stmt);
-      throw bad_lemon(errmsg);
-   }
-
-   sqlite3_finalize(stmt);
+   // all written in the same batch, after the screen is back
+   if (g->is_broken())
+      _writer->broken(g->rom());
+   else
+      _writer->played(g->rom(), started);
+   _writer->session(g->rom(), started, ended, result.wall_ms, result.exit_code);
+   _launch_log->mark(span_db);
 }
 
 void lemon_menu::handle_up_menu()
 {
-   if (_current != _top) {
+   if (_search) {
+      end_search();
+   } else if (_current != _top) {
       _current = (menu*)_current->parent();
       reset_snap_timer();
-      render();
+      _redraw = true;
    }
 }
 
@@ -482,16 +743,101 @@ void lemon_menu::handle_down_menu()
 {
    _current = (menu*)_current->selected();
    reset_snap_timer();
-   render();
+   _redraw = true;
 }
 
 void lemon_menu::update_snap()
 {
-   if (_current->has_children()) {
-      item* item = _current->selected();
-      _layout->snap(item->snapshot());
-      render();
+   if (!_current->has_children())
+      return;
+
+   item* item = _current->selected();
+   if (typeid(game) != typeid(*item)) {
+      _layout->snap(NULL);
+      _redraw = true;
+      return;
    }
+
+   game* g = (game*)item;
+   SDL_Surface* cached = _snap_cache.get(g->rom());
+   string file;
+   
+   // the selection settled, chances are this game is run next
+   if (_rom_warmer)
+      _rom_warmer->request(g->rom(), _catalog->parent(g));
+
+   if (cached) {
+      // the cache keeps its own reference
+      cached->refcount++;
+      _layout->snap(cached);
+      _redraw = true;
+   } else if (g->snapshot_file(file)) {
+      // loading is done by the snap loader thread, the result arrives as
+      // an event and is handled by handle_snap_loaded
+      log << debug << "update_snap: " << file << endl;
+      _snap_loader->request(g->rom(), file);
+   } else {
+      _layout->snap(NULL);
+      _redraw = true;
+   }
+
+   prefetch_snaps();
+}
+
+void lemon_menu::prefetch_snaps()
+{
+   vector<snap_request> requests;
+   vector<item*>::iterator sel = _current->selected_begin();
+   string file;
+
+   // nearest neighbours first, alternating below and above the selection
+   for (int i = 1; i <= _snap_prefetch; i++) {
+      item* neighbours[2] = { NULL, NULL };
+
+      if (_current->last() - sel > i)
+         neighbours[0] = *(sel + i);
+      if (sel - _current->first() >= i)
+         neighbours[1] = *(sel - i);
+
+      for (int n = 0; n < 2; n++) {
+         game* g = (game*)neighbours[n];
+         if (!g || typeid(game) != typeid(*g) || _snap_cache.get(g->rom()))
+            continue;
+
+         if (g->snapshot_file(file))
+            requests.push_back(snap_request(g->rom(), file));
+      }
+   }
+
+   _snap_loader->prefetch(requests);
+}
+
+void lemon_menu::handle_snap_loaded(snap_result* result)
+{
+   item* item = _current->has_children()? _current->selected() : NULL;
+   SDL_Surface* surface = NULL;
+   bool cached = false;
+
+   if (result->surface) {
+      surface = _layout->display_format(result->surface);
+      cached = _snap_cache.put(result->rom, surface);
+   } else {
+      log << debug << "handle_snap_loaded: unable to load " << result->file << endl;
+   }
+
+   // prefetched snapshots are only cached, the snap timer shows them
+   if (!result->prefetch && item && typeid(game) == typeid(*item) &&
+         result->rom == ((game*)item)->rom()) {
+      if (cached)
+         surface->refcount++;
+
+      _layout->snap(surface);
+      _redraw = true;
+   } else if (surface && !cached) {
+      SDL_FreeSurface(surface);
+   }
+
+   delete result;
 }
 
 void lemon_menu::reset_snap_timer()
@@ -499,6 +845,11 @@ void lemon_menu::reset_snap_timer()
    if (_snap_timer)
       SDL_RemoveTimer(_snap_timer);
 
+   // selection changed, any snapshot being loaded is no longer wanted
+   _snap_loader->cancel();
+   if (_rom_warmer)
+      _rom_warmer->cancel();
+
    // schedule timer to run in 500 milliseconds
    _snap_timer = SDL_AddTimer(_snap_delay, snap_timer_callback, NULL);
 }
@@ -513,116 +864,181 @@ void lemon_menu::stop_joystick_repeat_timer(joystick_repeat_config *config)
 {
    if (config->timer)
       SDL_RemoveTimer(config->timer);
+
+   config->timer = 0;
+   config->direction = 0;
 }
 
-void lemon_menu::change_view(view_t view)
+void lemon_menu::change_view(int view)
 {
    _view = view;
    
-   // recurisvely free top menu / children
-   if (_top != NULL)
-      delete _top;
+   // a search only covers the view it was started in
+   if (_search) {
+      SDL_EnableUNICODE(0);
+      delete _search;
+      _search = NULL;
+      _matches.clear();
+   }
+   
+   // menus are kept between view changes, unless the catalog changed the
+   // order of the view since it was built
+   if (_stale[_view]) {
+      delete _views[_view];
+      _views[_view] = build_view(_view);
+      _stale[_view] = false;
+   }
+   
+   _current = _top = _views[_view];
    
-   // create new top menu
-   _current = _top = new menu(view_names[_view]);
+   // new menu may well end up at the address of the old one
+   _layout->invalidate();
+}
+
+void lemon_menu::start_search()
+{
+   // typed characters are needed rather than keys
+   SDL_EnableUNICODE(1);
+   
+   _search_return = _current;
+   _query.clear();
+   
+   // every game in the view matches the empty query
+   _matches.clear();
+   _matches.push_back(_catalog->view(_view));
+   
+   show_matches();
+}
+
+void lemon_menu::end_search()
+{
+   SDL_EnableUNICODE(0);
    
-   string query("SELECT filename, name, params, genre, favourite, broken FROM games");
-   string where, order;
+   delete _search;
+   _search = NULL;
+   _matches.clear();
    
-   switch (_view) {
-   case favorite:
-      order.append("name");
-      where.append("favourite = 1");
-      break;
+   _current = _search_return;
+   _layout->invalidate();
+   reset_snap_timer();
+   _redraw = true;
+}
+
+void lemon_menu::show_matches()
+{
+   string title("Search: ");
+   title.append(_query);
+   
+   menu* results = new menu(title.c_str());
+   const vector<Uint32>& matches = _matches.back();
+   
+   for (vector<Uint32>::const_iterator i = matches.begin(); i != matches.end(); i++)
+      results->add_child(_catalog->at(*i), false);
+   
+   // few names contain the text, add the closest of the rest in case it
+   // was misspelt or the words are in a different order
+   if (matches.size() < SEARCH_CLOSE_MATCHES && _query.size() >= 3) {
+      Uint32 start = SDL_GetTicks();
       
-   case most_played:
-      order.append("count DESC,name");
-      where.append("count > 0");
-      break;
+      // only games in the view the search started in that aren't listed
+      // yet, filtered before the best are picked so small views get some
+      vector<bool> allowed(_catalog->size(), false);
+      const vector<Uint32>& view = _matches.front();
+      for (vector<Uint32>::const_iterator i = view.begin(); i != view.end(); i++)
+         allowed[*i] = true;
+      for (vector<Uint32>::const_iterator i = matches.begin(); i != matches.end(); i++)
+         allowed[*i] = false;
       
-   case genre:
-      order.append("genre,name");
-      break;
+      vector<Uint32> close;
+      _trigrams->search(_query.c_str(), *_catalog, allowed,
+            SEARCH_CLOSE_MATCHES - matches.size(), close);
       
-   case all:
-      order.append("name");
-      break;
-   }
-   
-   if (!_show_hidden) {
-      if (where.length() != 0) where.append(" AND ");
-      where.append("hide = 0 AND missing = 0");
+      for (vector<Uint32>::iterator i = close.begin(); i != close.end(); i++)
+         results->add_child(_catalog->at(*i), false);
+      
+      Uint32 elapsed = SDL_GetTicks() - start;
+      log << (elapsed > SEARCH_CLOSE_MS? warn : debug) << "show_matches: "
+            << close.size() << " close matches in " << elapsed << " ms, target "
+            << SEARCH_CLOSE_MS << " ms" << endl;
    }
    
-   // assemble query
-   query.append(" WHERE ").append(where);
-   query.append(" ORDER BY ").append(order);
-   
-   log << debug << "change_view: " << query.c_str() << endl;
+   delete _search;
+   _current = _search = results;
    
-   sqlite3_stmt *stmt;
-   int rc;
-   try {
-      assert_sqlite(sqlite3_prepare_v2(_db, query.c_str(), -1, &stmt, NULL) == SQLITE_OK);
-      while((rc = sqlite3_step(stmt)) == SQLITE_ROW)
-      {
-         insert_game(stmt);
+   _layout->invalidate();
+   reset_snap_timer();
+   _redraw = true;
+}
+
+void lemon_menu::handle_search_key(SDLKey key)
+{
+   // text is typed when keys go down, other than the select and back keys
+   // which keep working while searching even when they are printable
+   if (key == g_opts.get_int(KEY_KEYCODE_EXIT) ||
+         key == g_opts.get_int(KEY_KEYCODE_BACK)) {
+      end_search();
+   } else if (key == SDLK_RETURN || key == g_opts.get_int(KEY_KEYCODE_SELECT)) {
+      handle_activate();
+   } else if (key == SDLK_BACKSPACE) {
+      // results for the shorter query are still around
+      if (_query.empty()) {
+         end_search();
+      } else {
+         _query.erase(_query.size() - 1);
+         _matches.pop_back();
+         show_matches();
       }
-      assert_sqlite(rc == SQLITE_DONE);
-   } catch (sqlite_exception ex) {
-         const char *errmsg = sqlite3_errmsg(_db);
-         sqlite3_finalize(stmt);
-         throw bad_lemon(errmsg);
    }
+}
 
-   sqlite3_finalize(stmt);
+void lemon_menu::handle_search_text(char c)
+{
+   Uint32 start = SDL_GetTicks();
+   
+   _query.push_back(tolower(c));
+   
+   // anything matching the longer query matched the shorter one too, so
+   // only the previous matches need to be looked at
+   _matches.push_back(vector<Uint32>());
+   const vector<Uint32>& previous = _matches[_matches.size() - 2];
+   vector<Uint32>& matches = _matches.back();
+   
+   for (vector<Uint32>::const_iterator i = previous.begin(); i != previous.end(); i++)
+      if (strstr(_catalog->folded(*i), _query.c_str()))
+         matches.push_back(*i);
+   
+   log << debug << "handle_search_text: " << _query << ": " << matches.size()
+         << " of " << previous.size() << " in " << SDL_GetTicks() - start
+         << " ms" << endl;
+   
+   show_matches();
 }
 
-void lemon_menu::insert_game(sqlite3_stmt *stmt)
+menu* lemon_menu::build_view(int view)
 {
-   menu* top = this->top();
+   Uint32 start = SDL_GetTicks();
    
-   game* g = new game(
-      (char *)sqlite3_column_text(stmt, 0), // filename
-      (char *)sqlite3_column_text(stmt, 1), // name
-      (char *)sqlite3_column_text(stmt, 2), // params
-      sqlite3_column_int(stmt, 4),          // favourite
-      sqlite3_column_int(stmt, 5)           // broken
-   );
+   const view_def& def = _catalog->def(view);
+   menu* top = new menu(def.title.c_str());
+   menu* m = top;
+   string title;
    
-   switch (this->view()) {
-   case favorite:
-   case most_played:
-   case all:
-      top->add_child(g);
-      
-      break;
-      
-   case genre:
-      char* genre_name = (char *)sqlite3_column_text(stmt, 3);
-      menu* m = NULL;
-      if (!top->has_children()) {
-         // if top menu doesn't have a menu yet, create one for the genre
-         m = new menu(genre_name);
+   const vector<Uint32>& indexes = _catalog->view(view);
+   for (vector<Uint32>::const_iterator i = indexes.begin(); i != indexes.end(); i++) {
+      // games are sorted by group first, start a new menu for each group
+      if (def.group != key_none && (m == top || !_catalog->same_group(view, *(i-1), *i))) {
+         _catalog->group_title(view, *i, title);
+         m = new menu(title.c_str());
          top->add_child(m);
-      } else {
-         // get last child of the top level menu
-         vector<item*>::iterator i = top->last();
-         --i; // move iterator to the last item in list
-         
-         m = (menu*)*i;
-
-         // create new child menu of the genre strings don't match
-         if (strcmp(m->text(), genre_name) != 0) {
-            m = new menu(genre_name);
-            top->add_child(m);
-         }
       }
       
-      m->add_child(g);
-
-      break;
+      m->add_child(_catalog->at(*i), false);
    }
+   
+   log << debug << "build_view: " << def.title << ": " << indexes.size()
+         << " games in " << SDL_GetTicks() - start << " ms" << endl;
+   
+   return top;
 }
 
 Uint32 snap_timer_callback(Uint32 interval, void *param)
@@ -636,6 +1052,17 @@ Uint32 snap_timer_callback(Uint32 interval, void *param)
    return 0;
 }
 
+Uint32 frame_timer_callback(Uint32 interval, void *param)
+{
+   SDL_Event evt;
+   evt.type = SDL_USEREVENT;
+   evt.user.code = FRAME_EVENT;
+
+   SDL_PushEvent(&evt);
+
+   return 0;
+}
+
 Uint32 joystick_repeat_timer_callback(Uint32 interval, void *param)
 {
    SDL_Event evt;
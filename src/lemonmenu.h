@@ -26,16 +26,19 @@
 
 #include "lemonui.h"
 #include "menu.h"
+#include "catalog.h"
+#include "trigramindex.h"
+#include "snaploader.h"
+#include "dbwriter.h"
+#include "launcher.h"
+#include "romwarmer.h"
+#include "launchlog.h"
+#include "surfacecache.h"
 #include "options.h"
 #include "log.h"
 
 namespace ll {
 
-typedef enum { favorite, most_played, genre, all } view_t;
-static const char* view_names[] = {
-      "Favorites", "Most Played", "Genres", "All"
-};
-
 // struct to hold joystick axis repeat data
 typedef struct {
 	int axis;
@@ -48,29 +51,68 @@ typedef struct {
 class lemon_menu {
 private:
    sqlite3* _db;
+   stmt_cache* _stmts; // statements run on the main connection
+   db_writer* _writer; // game status changes are written behind
+   launcher* _launcher;
    lemonui* _layout;
 
    bool _running;
    bool _show_hidden;
+   bool _redraw; // render once all pending events are handled
+
+   Uint32 _frame_period; // minimum ms between frames, 0 when unpaced
+   Uint32 _last_frame;   // ticks when the last frame was started
+   SDL_TimerID _frame_timer;
+   vector<Uint32> _frame_times; // render durations for debug statistics
+   
+   const int _launch_mode; // what is shut down while the emulator runs
+   launch_log* _launch_log; // active until the menu is drawn after a launch
 
+   catalog* _catalog;
+   trigram_index* _trigrams; // close matches for searches
+   vector<menu*> _views; // menus built for each view so far
+   vector<bool> _stale;  // view menu must be rebuilt when next shown
    menu* _top;
    menu* _current;
-   view_t _view;
+   int _view;
+   
+   menu* _search;        // search results, NULL when not searching
+   menu* _search_return; // menu shown when the search was started
+   string _query;        // lowercase search text
+   vector< vector<Uint32> > _matches; // games matching each prefix of the query
    
    const int _snap_delay;
    SDL_TimerID  _snap_timer;
+   thumb_cache* _thumbs;
+   snap_loader* _snap_loader;
+   rom_warmer* _rom_warmer; // NULL when there is no rom path
+   const int _snap_prefetch;
+   surface_cache<string> _snap_cache; // display ready snapshots by rom name
    const int _joystick_repeat_delay;
    const int _joystick_repeat_period;
    joystick_repeat_config _joystick_repeat_config_x;
    joystick_repeat_config _joystick_repeat_config_y;
 
+   void migrate();
+   void log_sql(const char* what);
    void render();
+   void schedule_render();
+   void log_frame_stats();
 
    void reset_snap_timer();
    void update_snap();
+   void handle_snap_loaded(snap_result* result);
+   void prefetch_snaps();
    void start_joystick_repeat_timer(joystick_repeat_config *config, bool repeating);
    void stop_joystick_repeat_timer(joystick_repeat_config *config);
-   void change_view(view_t view);
+   void change_view(int view);
+   
+   void start_search();
+   void end_search();
+   void show_matches();
+   void handle_search_key(SDLKey key);
+   void handle_search_text(char c);
+   menu* build_view(int view);
 
    void handle_up();
    void handle_down();
@@ -85,8 +127,6 @@ private:
    void handle_down_menu();
    void handle_activate();
    void handle_toggle_favorite();
-   
-   void insert_game(sqlite3_stmt *stmt);
 
 public:
    lemon_menu(lemonui* ui);
@@ -98,7 +138,7 @@ public:
    menu* top() const
    { return _top; }
    
-   const view_t view() const
+   const int view() const
    { return _view; }
 };
 
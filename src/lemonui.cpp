@@ -40,6 +40,98 @@ using namespace std;
 const inline int min(int a, int b)
 { return a > b? b : a; }
 
+/** Returns true if the two rects overlap */
+static bool intersects(const SDL_Rect& a, const SDL_Rect& b)
+{
+   return a.x < b.x + b.w && b.x < a.x + a.w &&
+      a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+/** Returns true if outer completely covers inner */
+static bool contains(const SDL_Rect& outer, const SDL_Rect& inner)
+{
+   return outer.x <= inner.x && outer.y <= inner.y &&
+      outer.x + outer.w >= inner.x + inner.w &&
+      outer.y + outer.h >= inner.y + inner.h;
+}
+
+/**
+ * Copies n pixels of size bpp bytes, stepping through the source and
+ * destination by the given number of bytes.
+ */
+template <int bpp>
+static inline void copy_pixels(const Uint8* src, int src_step, Uint8* dest, int dest_step, int n)
+{
+   for (; n > 0; n--, src += src_step, dest += dest_step) {
+      if (bpp == 4)
+         *(Uint32*)dest = *(const Uint32*)src;
+      else if (bpp == 2)
+         *(Uint16*)dest = *(const Uint16*)src;
+      else if (bpp == 1)
+         *dest = *src;
+      else
+         memcpy(dest, src, bpp);
+   }
+}
+
+/**
+ * Copies rect of src to dest rotated counter-clockwise by the given angle
+ * (90, 180 or 270), same as rotozoomSurface does for the whole surface.
+ * Both surfaces must have the same pixel format.
+ * @return rect of dest that was drawn
+ */
+static SDL_Rect blit_rotated(SDL_Surface* src, const SDL_Rect& rect, SDL_Surface* dest, int angle)
+{
+   // top left corner of rect in dest and the direction a step to the
+   // right along a source row takes in dest
+   SDL_Rect out;
+   int bpp = src->format->BytesPerPixel;
+   int x0, y0, step;
+   
+   if (angle == 90) {
+      out.x = rect.y;
+      out.y = src->w - (rect.x + rect.w);
+      out.w = rect.h; out.h = rect.w;
+      x0 = rect.y; y0 = src->w - 1 - rect.x;
+      step = -dest->pitch;
+   } else if (angle == 270) {
+      out.x = src->h - (rect.y + rect.h);
+      out.y = rect.x;
+      out.w = rect.h; out.h = rect.w;
+      x0 = src->h - 1 - rect.y; y0 = rect.x;
+      step = dest->pitch;
+   } else {
+      out.x = src->w - (rect.x + rect.w);
+      out.y = src->h - (rect.y + rect.h);
+      out.w = rect.w; out.h = rect.h;
+      x0 = src->w - 1 - rect.x; y0 = src->h - 1 - rect.y;
+      step = -bpp;
+   }
+   
+   // each following source row moves one pixel in dest
+   int row_step = angle == 90? bpp : angle == 270? -bpp : -dest->pitch;
+   
+   SDL_LockSurface(src);
+   SDL_LockSurface(dest);
+   
+   const Uint8* s = (const Uint8*)src->pixels + rect.y * src->pitch + rect.x * bpp;
+   Uint8* d = (Uint8*)dest->pixels + y0 * dest->pitch + x0 * bpp;
+   
+   for (int y = 0; y < rect.h; y++, s += src->pitch, d += row_step) {
+      switch (bpp) {
+      case 4: copy_pixels<4>(s, 4, d, step, rect.w); break;
+      case 3: copy_pixels<3>(s, 3, d, step, rect.w); break;
+      case 2: copy_pixels<2>(s, 2, d, step, rect.w); break;
+      default: copy_pixels<1>(s, 1, d, step, rect.w); break;
+      }
+   }
+   
+   SDL_UnlockSurface(dest);
+   SDL_UnlockSurface(src);
+   
+   return out;
+}
+
 int cb_dimension(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result)
 {
    if (strcmp(value, "full") == 0)
@@ -83,9 +175,14 @@ int cb_validate_pos_dims(cfg_t *cfg, cfg_opt_t *opt)
 }
 
 lemonui::lemonui(const char* theme_file):
-   _bg(NULL), _snap(NULL), _buffer(NULL), _screen(NULL),
-   _title_font(NULL), _list_font(NULL)
+   _bg(NULL), _snap(NULL), _buffer(NULL), _screen(NULL), _title(NULL),
+   _title_font(NULL), _list_font(NULL),
+   _list_menu(NULL), _list_selected(NULL), _list_state(normal_state),
+   _dirty(dirty_full),
+   _text_cache(g_opts.get_int(KEY_TEXT_CACHE) * 1024)
 {
+   memset(&_format, 0, sizeof(_format));
+   
    _rotate = g_opts.get_int(KEY_ROTATE);
    _scrnw = g_opts.get_int(KEY_SCREEN_WIDTH);
    _scrnh = g_opts.get_int(KEY_SCREEN_HEIGHT);
@@ -93,8 +190,8 @@ lemonui::lemonui(const char* theme_file):
    /*
     * When rotation is requested we swap the width/height for the drawing
     * buffer and simply draw as if it was oriented the same as the screen
-    * resolution.  Then after drawing is finished, the drawing buffer is
-    * rotated before it is blitted to the screen.
+    * resolution.  Then after drawing is finished, the changed areas of the
+    * drawing buffer are copied to the screen rotated.
     */
    if (_rotate == 90 || _rotate == 270) {
       _buffw = _scrnh;
@@ -250,6 +347,11 @@ lemonui::lemonui(const char* theme_file):
 
 lemonui::~lemonui()
 {
+   _text_cache.clear(); // free cached text before the font engine goes
+   
+   if (_title)
+      SDL_FreeSurface(_title);
+   
    if (_bg) // free background image
       SDL_FreeSurface(_bg);
    
@@ -266,10 +368,14 @@ lemonui::~lemonui()
    destroy_screen();
 }
 
-void lemonui::setup_screen() throw(bad_lemon&)
+bool lemonui::setup_screen() throw(bad_lemon&)
 {
-   // initialize sdl
-   SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_JOYSTICK);
+   // initialize sdl, only the video is gone when the screen was released
+   bool joysticks = !SDL_WasInit(SDL_INIT_JOYSTICK);
+   if (joysticks)
+      SDL_Init(SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_JOYSTICK);
+   
+   SDL_InitSubSystem(SDL_INIT_VIDEO);
            
    // hide mouse cursor
    SDL_ShowCursor(SDL_DISABLE);
@@ -289,20 +395,54 @@ void lemonui::setup_screen() throw(bad_lemon&)
    if (!_screen)
       throw bad_lemon("layout: unable to open screen");
    
+   // surfaces converted for a previous screen are useless if its format
+   // was different, they would go through the slow conversion blitter
+   SDL_PixelFormat* fmt = _screen->format;
+   bool changed = fmt->BitsPerPixel != _format.BitsPerPixel ||
+         fmt->Rmask != _format.Rmask || fmt->Gmask != _format.Gmask ||
+         fmt->Bmask != _format.Bmask;
+   if (changed) {
+      _text_cache.clear();
+      
+      if (_title) {
+         SDL_FreeSurface(_title);
+         _title = NULL;
+      }
+      
+      // a cached copy of the snapshot keeps its own reference
+      if (_snap)
+         _snap = display_format(_snap);
+   }
+   _format = *fmt;
+   
+   if (_bg)
+      _bg = display_format(_bg);
+   
    /*
     * Should I be using hardware surface?  Most docs/guides suggest no..
     * I pass 0 as the alpha mask.  Surfaces don't need an alpha channel to
     * do per-surface alpha and blitting.  In fact I can't seem to get the
     * fadded snapshot blitting to work at all if the alpha channel is set!
+    *
+    * Unrotated frames are drawn straight onto the screen, which is a
+    * software surface anyway.  Rotated frames are copied to the screen
+    * pixel by pixel, which needs the buffer to be in the screen format.
     */
-   _buffer = SDL_CreateRGBSurface(SDL_SWSURFACE,
-      _buffw, _buffh, 32, // w,h,bpp
-      0x000000ff, 0x0000ff00, 0x00ff0000, 0x00000000); // rgba masks, for big-endian
+   if (_rotate != 0) {
+      _buffer = SDL_CreateRGBSurface(SDL_SWSURFACE,
+         _buffw, _buffh, fmt->BitsPerPixel,
+         fmt->Rmask, fmt->Gmask, fmt->Bmask, 0x00000000);
+   } else {
+      _buffer = _screen;
+   }
 
    if (!_buffer)
       throw bad_lemon("layout: unable to create drawing buffer");
+   
+   // new buffer has nothing in it yet
+   _dirty |= dirty_full;
 
-   int num_joysticks = SDL_NumJoysticks();
+   int num_joysticks = joysticks? SDL_NumJoysticks() : 0;
    SDL_Joystick *joystick;
 
    for (int i = 0; i < num_joysticks; i++ )
@@ -312,24 +452,100 @@ void lemonui::setup_screen() throw(bad_lemon&)
    }
 
    SDL_JoystickEventState(SDL_ENABLE);
+   
+   return changed;
+}
+
+void lemonui::release_screen()
+{
+   if (_buffer && _buffer != _screen) // free rendering buffer
+      SDL_FreeSurface(_buffer);
+   
+   _buffer = NULL;
+   _screen = NULL;
+   
+   SDL_QuitSubSystem(SDL_INIT_VIDEO); // closes the window or frees the console
 }
 
 void lemonui::destroy_screen()
 {
-   if (_buffer) { // free rendering buffer
+   if (_buffer && _buffer != _screen) // free rendering buffer
       SDL_FreeSurface(_buffer);
-      _buffer = NULL;
-   }
+   
+   _buffer = NULL;
+   _screen = NULL;
       
    SDL_Quit(); // shutdown sdl
 }
 
+SDL_Surface* lemonui::prepare_snap(SDL_Surface* snap) const
+{
+   if (!snap)
+      return NULL;
+   
+   float xscale = (float)_snap_rect.w / snap->w;
+   float yscale = (float)_snap_rect.h / snap->h;
+
+   // width aspect is larger than target, use 
+   if (xscale > yscale) {
+      xscale = yscale;
+   } else if (yscale > xscale) {
+      yscale = xscale;
+   }
+
+   // created scaled version of snapshot surface
+   SDL_Surface* scaled = rotozoomSurfaceXY(snap, 0.0, xscale, yscale, 0);
+   SDL_FreeSurface(snap);
+   
+   if (!scaled)
+      return NULL;
+   
+   // rotozoomer surface has alpha channel, clear it so the fade is opaque
+   scaled->format->Amask = 0x00000000;
+   
+   // fade the snapshot by blitting black over it with per-surface alpha
+   SDL_PixelFormat* fmt = scaled->format;
+   SDL_Surface* shade = SDL_CreateRGBSurface(SDL_SWSURFACE,
+      scaled->w, scaled->h, fmt->BitsPerPixel,
+      fmt->Rmask, fmt->Gmask, fmt->Bmask, 0);
+   
+   if (shade) {
+      SDL_FillRect(shade, NULL, RGB(0,0,0));
+      SDL_SetAlpha(shade, SDL_SRCALPHA, _snap_alpha);
+      SDL_BlitSurface(shade, NULL, scaled, NULL);
+      SDL_FreeSurface(shade);
+   }
+   
+   return scaled;
+}
+
+SDL_Surface* lemonui::display_format(SDL_Surface* surface, bool alpha) const
+{
+   SDL_Surface* converted = alpha?
+      SDL_DisplayFormatAlpha(surface) : SDL_DisplayFormat(surface);
+   if (!converted)
+      return surface;
+   
+   SDL_FreeSurface(surface);
+   return converted;
+}
+
 void lemonui::snap(SDL_Surface* snap)
 {
    if (_snap)
       SDL_FreeSurface(_snap);
    
    _snap = snap;
+   _dirty |= dirty_snap;
+   
+   if (!snap)
+      return;
+   
+   // center the snapshot within the target rect
+   _snap_pos.w = _snap->w;
+   _snap_pos.h = _snap->h;
+   _snap_pos.x = _snap_rect.x + (_snap_rect.w - _snap_pos.w) / 2;
+   _snap_pos.y = _snap_rect.y + (_snap_rect.h - _snap_pos.h) / 2;
 }
 
 void lemonui::parse_dimensions(SDL_Rect* rect, cfg_t* sec)
@@ -351,9 +567,27 @@ void lemonui::normalize(const char* path, string& new_path)
    }
 }
 
-void lemonui::render_item(SDL_Surface* buffer, item* i, int yoff)
+void lemonui::render_item(SDL_Surface* buffer, item* i, bool selected, int yoff)
 {
-   SDL_Surface* surface = i->draw(_list_font, _list_color, _list_hover_color, _list_emphasis_color, _list_emphasis_hover_color, _list_broken_color, _list_broken_hover_color);
+   // rasterizing text is expensive, only do it when the item isn't cached
+   text_key key(i->text(), i->state(), selected);
+   SDL_Surface* surface = _text_cache.get(key);
+   bool cached = true;
+   
+   if (!surface) {
+      // games are listed in several menus at once so their parent can't
+      // tell if they're selected here, pass only the colors that apply
+      SDL_Color normal = selected? _list_hover_color : _list_color;
+      SDL_Color emphasis = selected? _list_emphasis_hover_color : _list_emphasis_color;
+      SDL_Color broken = selected? _list_broken_hover_color : _list_broken_color;
+      
+      surface = i->draw(_list_font, normal, normal, emphasis, emphasis, broken, broken);
+      if (!surface) return;
+      
+      surface = display_format(surface, true);
+      
+      cached = _text_cache.put(key, surface);
+   }
    
    SDL_Rect src, dest;
 
@@ -371,75 +605,20 @@ void lemonui::render_item(SDL_Surface* buffer, item* i, int yoff)
    dest.y = yoff;
    
    SDL_BlitSurface(surface, &src, buffer, &dest);
-   SDL_FreeSurface(surface);
+   
+   // surface is owned by the cache unless it was too large to be kept
+   if (!cached)
+      SDL_FreeSurface(surface);
 }
 
-void lemonui::render(menu* current)
+void lemonui::render_list(menu* current)
 {
-   // clear back buffer
-   if (_bg == NULL)
-      SDL_FillRect(_buffer, NULL, RGB(0,0,0));
-   else
-      SDL_BlitSurface(_bg, NULL, _buffer, NULL);
-
-   // draw the games screen shot
-   if (_snap) {
-      float xscale = (float)_snap_rect.w / _snap->w;
-      float yscale = (float)_snap_rect.h / _snap->h;
-
-      // width aspect is larger than target, use 
-      if (xscale > yscale) {
-         xscale = yscale;
-      } else if (yscale > xscale) {
-         yscale = xscale;
-      }
-
-      // created scaled version of snapshot surface
-      SDL_Surface* scaled = rotozoomSurfaceXY(_snap, 0.0, xscale, yscale, 0);
-      
-      // center the snapshot within the target rect
-      SDL_Rect snap_rect;
-      snap_rect.w = scaled->w;
-      snap_rect.h = scaled->h;
-      snap_rect.x = _snap_rect.x + (_snap_rect.w - snap_rect.w) / 2;
-      snap_rect.y = _snap_rect.y + (_snap_rect.h - snap_rect.h) / 2;
-      
-      SDL_BlitSurface(scaled, NULL, _buffer, &snap_rect);
-      
-      // rotozoomer surface has alpha channel, clear it to do per-surface alpha blit
-      scaled->format->Amask = 0x00000000;
-      
-      // fill scaled surface with black and do alpha blit
-      SDL_FillRect(scaled, NULL, RGB(0,0,0));
-      SDL_SetAlpha(scaled, SDL_SRCALPHA, _snap_alpha);
-      SDL_BlitSurface(scaled, NULL, _buffer, &snap_rect);
-      
-      // free scaled surface
-      SDL_FreeSurface(scaled);
-   }
-
-   SDL_Surface* title =
-      TTF_RenderText_Blended(_title_font, current->text(), RGB_SDL_Color(_title_color));
-   
-   SDL_Rect title_rect = _title_rect;
-   
-   if (_title_justify == right_justify)
-      title_rect.x += _title_rect.w - title->w;
-   else if (_title_justify == center_justify)
-      title_rect.x += (_title_rect.w - title->w) / 2;
-   
-   // draw title to back buffer
-   SDL_BlitSurface(title, NULL, _buffer, &title_rect);
-
-   // finished with the title surface
-   SDL_FreeSurface(title);
-   
    // only render list of children, if there is any
    if (current->has_children()) {
       int yoff = _list_rect.y + ((_list_rect.h - _list_font_height) / 2);
       
       // draw the selected item in the middle of the list region
-      render_item(_buffer, current->selected(), yoff);
+      render_item(_buffer, current->selected(), true, yoff);
    
       // set absolute top/bottom of list area
       int top = _list_rect.y;
@@ -455,7 +634,7 @@ void lemonui::render(menu* current)
          do {
             --i;
             
-            render_item(_buffer, *i, yoff_above);
+            render_item(_buffer, *i, false, yoff_above);
             yoff_above -= _list_font_height + _list_item_spacing;
          } while (i != current->first() && yoff_above > top);
       }
@@ -465,19 +644,150 @@ void lemonui::render(menu* current)
       while (i+1 != current->last() && yoff_bellow + _list_font_height < bottom) {
          i++;
          
-         render_item(_buffer, *i, yoff_bellow);
+         render_item(_buffer, *i, false, yoff_bellow);
          
          yoff_bellow += _list_font_height + _list_item_spacing;
       }
    }
+}
+
+void lemonui::paint(menu* current, const SDL_Rect& area)
+{
+   // everything drawn below is clipped to the area being repainted
+   SDL_Rect clip = area;
+   SDL_SetClipRect(_buffer, &clip);
    
-   if (_rotate != 0) {
-      SDL_Surface* tmp = rotozoomSurface(_buffer, _rotate, 1, 0);
-      SDL_BlitSurface(tmp, NULL, _screen, NULL);
-      SDL_UpdateRect(_screen, 0, 0, 0, 0);
-      SDL_FreeSurface(tmp);
+   // clear back buffer
+   if (_bg == NULL)
+      SDL_FillRect(_buffer, NULL, RGB(0,0,0));
+   else
+      SDL_BlitSurface(_bg, NULL, _buffer, NULL);
+
+   // draw the games screen shot, already scaled and faded by snap()
+   if (_snap) {
+      SDL_Rect snap_rect = _snap_pos;
+      SDL_BlitSurface(_snap, NULL, _buffer, &snap_rect);
+   }
+
+   if (_title && intersects(area, _title_rect)) {
+      SDL_Rect title_rect = _title_rect;
+      
+      if (_title_justify == right_justify)
+         title_rect.x += _title_rect.w - _title->w;
+      else if (_title_justify == center_justify)
+         title_rect.x += (_title_rect.w - _title->w) / 2;
+      
+      // draw title to back buffer
+      SDL_BlitSurface(_title, NULL, _buffer, &title_rect);
+   }
+   
+   if (intersects(area, _list_rect))
+      render_list(current);
+   
+   SDL_SetClipRect(_buffer, NULL);
+}
+
+void lemonui::present(SDL_Rect* rects, int count)
+{
+   if (_buffer != _screen) {
+      SDL_Rect screen_rects[3];
+      
+      for (int i = 0; i < count; i++)
+         screen_rects[i] = blit_rotated(_buffer, rects[i], _screen, _rotate);
+      
+      SDL_UpdateRects(_screen, count, screen_rects);
    } else {
-      SDL_BlitSurface(_buffer, NULL, _screen, NULL);
-      SDL_UpdateRect(_screen, 0, 0, 0, 0);
+      // frame was drawn straight onto the screen
+      SDL_UpdateRects(_screen, count, rects);
+   }
+}
+
+void lemonui::invalidate()
+{
+   _dirty |= dirty_full;
+}
+
+void lemonui::render(menu* current)
+{
+   // title only needs rasterizing when the menu name changes
+   if (!_title || _title_text != current->text()) {
+      if (_title)
+         SDL_FreeSurface(_title);
+      
+      _title_text = current->text();
+      _title = TTF_RenderText_Blended(_title_font, current->text(),
+            RGB_SDL_Color(_title_color));
+      
+      if (_title)
+         _title = display_format(_title, true);
+      _dirty |= dirty_title;
    }
+   
+   // list needs repainting when the selection moves or changes state
+   item* selected = current->has_children()? current->selected() : NULL;
+   item_state_t state = selected? selected->state() : normal_state;
+   
+   if (current != _list_menu || selected != _list_selected || state != _list_state) {
+      _list_menu = current;
+      _list_selected = selected;
+      _list_state = state;
+      _dirty |= dirty_list;
+   }
+   
+   if (!_dirty)
+      return;
+   
+   SDL_Rect rects[3];
+   int count = 0;
+   
+   if (_dirty & dirty_full) {
+      rects[count].x = rects[count].y = 0;
+      rects[count].w = _buffw;
+      rects[count].h = _buffh;
+      count++;
+   } else {
+      if (_dirty & dirty_title)
+         add_rect(rects, count, _title_rect);
+      if (_dirty & dirty_list)
+         add_rect(rects, count, _list_rect);
+      if (_dirty & dirty_snap)
+         add_rect(rects, count, _snap_rect);
+   }
+   
+   for (int i = 0; i < count; i++)
+      paint(current, rects[i]);
+   
+   present(rects, count);
+   
+   _dirty = 0;
+}
+
+void lemonui::add_rect(SDL_Rect* rects, int& count, const SDL_Rect& rect)
+{
+   // keep within the buffer, SDL_UpdateRects doesn't clip
+   int x1 = rect.x < 0? 0 : rect.x;
+   int y1 = rect.y < 0? 0 : rect.y;
+   int x2 = min(rect.x + rect.w, _buffw);
+   int y2 = min(rect.y + rect.h, _buffh);
+   
+   if (x2 <= x1 || y2 <= y1)
+      return;
+   
+   SDL_Rect r;
+   r.x = x1; r.y = y1;
+   r.w = x2 - x1; r.h = y2 - y1;
+   
+   // regions often overlap (list and snapshot do by default), skip a region
+   // that is already covered and drop those covered by the new one
+   for (int i = 0; i < count; i++) {
+      if (contains(rects[i], r))
+         return;
+      
+      if (contains(r, rects[i])) {
+         rects[i] = rects[--count];
+         i--;
+      }
+   }
+   
+   rects[count++] = r;
 }
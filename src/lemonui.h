@@ -26,6 +26,7 @@
 #include <string>
 #include "error.h"
 #include "menu.h"
+#include "surfacecache.h"
 
 #define DIMENSION_FULL -1
 
@@ -33,6 +34,32 @@ namespace ll {
 
 typedef enum { left_justify, right_justify, center_justify } justify_t;
 
+/** Regions of the screen that need repainting */
+enum {
+   dirty_title = 1, dirty_list = 2, dirty_snap = 4,
+   dirty_full = 8 // entire screen, including areas outside the regions
+};
+
+/**
+ * Identifies a rendered list item surface.  Items are keyed by text rather
+ * than by pointer since menus are freed and rebuilt on every view change.
+ */
+struct text_key {
+   string text;
+   item_state_t state;
+   bool hover;
+   
+   text_key(const char* t, item_state_t s, bool h) :
+      text(t), state(s), hover(h) { }
+   
+   bool operator<(const text_key& other) const
+   {
+      if (state != other.state) return state < other.state;
+      if (hover != other.hover) return hover < other.hover;
+      return text < other.text;
+   }
+};
+
 /**
  * Class for handling layout and rendering of the interface
  */
@@ -41,9 +68,12 @@ private:
    std::string _theme_dir;
    
    SDL_Surface* _bg;
-   SDL_Surface* _snap;
-   SDL_Surface* _buffer;
+   SDL_Surface* _snap; // scaled and faded snapshot in display format
+   SDL_Surface* _buffer; // same as _screen when not rotating
    SDL_Surface* _screen;
+   SDL_PixelFormat _format; // screen format cached surfaces were made for
+   SDL_Surface* _title; // rendered title text
+   std::string _title_text;
    
    TTF_Font* _title_font;
    TTF_Font* _list_font;
@@ -70,10 +100,35 @@ private:
    int _rotate;
    
    SDL_Rect _snap_rect;
+   SDL_Rect _snap_pos; // where the scaled snapshot is centered in _snap_rect
    Uint8 _snap_alpha;
    
+   surface_cache<text_key> _text_cache; // rendered list item text
+   
+   // state of the list when it was last rendered
+   menu* _list_menu;
+   item* _list_selected;
+   item_state_t _list_state;
+   
+   int _dirty; // dirty_* flags of regions to repaint on next render
+   
    /** Render menu item at the given verticle offset */
-   void render_item(SDL_Surface* buffer, item* i, int yoff);
+   void render_item(SDL_Surface* buffer, item* i, bool selected, int yoff);
+   
+   /** Render the list of children of the current menu */
+   void render_list(menu* current);
+   
+   /** Repaint everything that falls inside area of the back buffer */
+   void paint(menu* current, const SDL_Rect& area);
+   
+   /** Copy the given areas of the back buffer to the screen */
+   void present(SDL_Rect* rects, int count);
+   
+   /**
+    * Adds rect clipped to the buffer to rects, unless an existing rect
+    * already covers it.  Existing rects covered by the new rect are removed.
+    */
+   void add_rect(SDL_Rect* rects, int& count, const SDL_Rect& rect);
    
    /**
     * Parses the dimensions option from the conf section and fills in the
@@ -102,25 +157,68 @@ public:
    
    /**
     * Setup screen and drawing buffer
+    * @return true when the screen format differs from the previous screen,
+    * display format surfaces kept elsewhere should be dropped
     */
-   void setup_screen() throw(bad_lemon&);
+   bool setup_screen() throw(bad_lemon&);
    
    /**
     * Destroy screen and drawing buffer
     */
    void destroy_screen();
+   
+   /**
+    * Destroy screen and drawing buffer, leaving the rest of sdl running.
+    * Fonts, cached surfaces, timers and joysticks are all still there for
+    * the next setup_screen.
+    */
+   void release_screen();
 
    /** Returns number of list items that fit in one page */
    const int page_size() const
    { return _page_size; }
    
+   /** Returns the region snapshots are scaled to fit */
+   const SDL_Rect& snap_rect() const
+   { return _snap_rect; }
+   
+   /** Returns the alpha snapshots are faded with */
+   const Uint8 snap_alpha() const
+   { return _snap_alpha; }
+   
    /**
-    * Sets the current snapshot image
+    * Scales a snapshot image to fit the snapshot region and fades it.  Only
+    * software surfaces are touched, so this is safe to call from a thread
+    * other than the one rendering.  The surface passed in is freed.
+    * @return newly created surface, or NULL if snap is NULL
+    */
+   SDL_Surface* prepare_snap(SDL_Surface* snap) const;
+   
+   /**
+    * Converts the surface to the display format so blitting it doesn't
+    * convert every frame.  The surface passed in is freed.
+    * @param alpha keep the per-pixel alpha of the surface
+    * @return converted surface, or the original if conversion failed
+    */
+   SDL_Surface* display_format(SDL_Surface* surface, bool alpha = false) const;
+   
+   /**
+    * Sets the current snapshot image, which must come from prepare_snap and
+    * should have been passed through display_format.  One reference to the
+    * surface is handed over, bump its refcount to keep using it elsewhere.
     */
    void snap(SDL_Surface* snap);
    
    /**
-    * Render the layout for the current menu
+    * Forces the whole screen to be repainted on the next render, for when
+    * the contents of the current menu changed behind its back
+    */
+   void invalidate();
+   
+   /**
+    * Render the layout for the current menu.  Only regions that changed
+    * since the last render (title, list, snapshot) are repainted and
+    * updated on the screen.
     */
    void render(menu* current);
 };
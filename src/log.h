@@ -62,6 +62,9 @@ public:
    
    void threshold(log_level level)
    { _threshold = level; }
+   
+   log_level threshold() const
+   { return _threshold; }
 };
 
 /**
@@ -84,6 +87,10 @@ public:
    void level(log_level level)
    { rdbuf()->threshold(level); }
    
+   /** Returns the most verbose level that is output */
+   log_level level() const
+   { return rdbuf()->threshold(); }
+   
    /** Returns a typesafe pointer to log buf */
    log_buf* rdbuf() const
    { return (log_buf*)ostream::rdbuf(); }
@@ -21,15 +21,48 @@
 #include "menu.h"
 #include "options.h"
 #include <cctype>
+#include <algorithm>
 
 using namespace ll;
 
 menu::~menu()
 {
-   for (vector<item*>::iterator i = _children.begin(); i != _children.end(); i++)
+   for (vector<item*>::iterator i = _owned.begin(); i != _owned.end(); i++)
       delete *i;
 }
 
+void menu::insert_child(int index, item* item, bool owned)
+{
+   if (owned) {
+      item->parent(this);
+      _owned.push_back(item);
+   }
+   _children.insert(_children.begin() + index, item);
+   _alpha.clear();
+   
+   // keep the selected child selected
+   if (index <= _selected && _children.size() > 1)
+      _selected++;
+}
+
+item* menu::remove_child(int index)
+{
+   item* child = _children[index];
+   _children.erase(_children.begin() + index);
+   _alpha.clear();
+   
+   vector<item*>::iterator i = find(_owned.begin(), _owned.end(), child);
+   if (i != _owned.end())
+      _owned.erase(i);
+   
+   // keep the selected child selected, or select the one after it
+   int last = _children.size() - 1;
+   if (index < _selected || (_selected > last && _selected > 0))
+      _selected--;
+   
+   return child;
+}
+
 const bool menu::select_index(int index)
 {
    if (_children.size() == 0 || _selected == index)
@@ -64,15 +97,56 @@ const bool menu::select_previous(int step)
    return false;
 }
 
-const bool menu::select_next_alpha()
+/** Lowercase first character of the item text */
+static int first_char(const item* i)
+{ return tolower((unsigned char)i->text()[0]); }
+
+void menu::index_alpha()
+{
+   if (!_alpha.empty())
+      return;
+   
+   for (int i = 0, last = _children.size()-1; i <= last; i++) {
+      int ch = first_char(_children[i]);
+      
+      if (_alpha.empty() || _alpha.back().ch != ch) {
+         alpha_run run = { i, ch };
+         _alpha.push_back(run);
+      }
+   }
+}
+
+int menu::alpha_run_of(int index) const
 {
-   // first character of selected child in lowercase
-   int sel_ch = tolower(_children[_selected]->text()[0]);
+   // last run starting at or before the index
+   int low = 0, high = _alpha.size()-1;
+   while (low < high) {
+      int mid = (low + high + 1) / 2;
+      if (_alpha[mid].start <= index)
+         low = mid;
+      else
+         high = mid - 1;
+   }
+   
+   return low;
+}
 
-   // iterate over children to find next in alphabetic order
-   for (int i=_selected, last=_children.size()-1; i <= last; i++) {
-      if (tolower(_children[i]->text()[0]) > sel_ch) {
-         _selected = i;
+const bool menu::select_next_alpha()
+{
+   if (_children.empty())
+      return false;
+   
+   // a sorted menu has a run per letter, so this only looks at a few dozen
+   // runs instead of every child up to the next letter
+   index_alpha();
+   
+   int run = alpha_run_of(_selected);
+   int sel_ch = _alpha[run].ch;
+   
+   // first child after the selection with a later letter
+   for (int r = run+1, last = _alpha.size()-1; r <= last; r++) {
+      if (_alpha[r].ch > sel_ch) {
+         _selected = _alpha[r].start;
          return true;
       }
    }
@@ -82,13 +156,19 @@ const bool menu::select_next_alpha()
 
 const bool menu::select_previous_alpha()
 {
-   // first character of selected child in lowercase
-   int sel_ch = tolower(_children[_selected]->text()[0]);
-
-   // iterate over children to find privious in alphabetic order
-   for (int i=_selected; i >= 0; i--) {
-      if (tolower(_children[i]->text()[0]) < sel_ch) {
-         _selected = i;
+   if (_children.empty())
+      return false;
+   
+   index_alpha();
+   
+   int run = alpha_run_of(_selected);
+   int sel_ch = _alpha[run].ch;
+   
+   // closest child before the selection with an earlier letter, which is
+   // the last child of its run
+   for (int r = run-1; r >= 0; r--) {
+      if (_alpha[r].ch < sel_ch) {
+         _selected = _alpha[r+1].start - 1;
          return true;
       }
    }
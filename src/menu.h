@@ -35,7 +35,20 @@ class menu : public item {
 private:
    string _name; // menu name
    vector<item*> _children; // array of children
+   vector<item*> _owned; // children deleted along with the menu
    int _selected; // index of selected child
+   
+   /** Run of consecutive children starting with the same letter */
+   struct alpha_run {
+      int start; // index of the first child in the run
+      int ch;    // lowercase first character
+   };
+   
+   /** Letter runs for alpha jumps, empty until needed after any change */
+   vector<alpha_run> _alpha;
+   
+   void index_alpha();
+   int alpha_run_of(int index) const;
 
 public:
    menu(const char* name) :
@@ -105,13 +118,38 @@ public:
    vector<item*>::iterator last()
    { return _children.end(); }
    
-   /** Appends the child item to the end of the children list */
-   void add_child(item* item)
+   /**
+    * Appends the child item to the end of the children list
+    * @param owned delete the child along with the menu, which becomes its
+    * parent
+    */
+   void add_child(item* item, bool owned = true)
    {
-      item->parent(this);
+      // items listed in several menus are left without a parent, any one
+      // of the menus could be gone by the time it is looked at
+      if (owned) {
+         item->parent(this);
+         _owned.push_back(item);
+      }
       _children.push_back(item);
+      _alpha.clear();
    }
 
+   /**
+    * Inserts the child item before the index-th child, the selected child
+    * stays selected
+    * @param owned delete the child along with the menu, which becomes its
+    * parent
+    */
+   void insert_child(int index, item* item, bool owned = true);
+   
+   /**
+    * Removes the index-th child.  The selection stays on the same child, or
+    * moves to the next one when the selected child is removed.
+    * @return removed child, the caller takes ownership if the menu owned it
+    */
+   item* remove_child(int index);
+
    /** Return menu name as item text */
    const char* text() const
    { return _name.c_str(); }
@@ -47,12 +47,33 @@ int cb_rotate(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result)
    return 0;
 }
 
+int cb_launch_mode(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result)
+{
+   if (strcmp(value, "restart") == 0)
+      *(int *)result = LAUNCH_RESTART;
+   else if (strcmp(value, "video") == 0)
+      *(int *)result = LAUNCH_VIDEO;
+   else {
+      cfg_error(cfg, "invalid value for option %s: %s", opt->name, value);
+      return -1;
+   }
+   
+   return 0;
+}
+
 options::options() : _cfg(NULL) { }
 
 void options::load(const char* conf_dir)
 {
    _conf_dir = (char*)conf_dir;
    
+   cfg_opt_t view_opts[] = {
+      CFG_STR(KEY_VIEW_FILTER, "all", CFGF_NONE),
+      CFG_STR(KEY_VIEW_GROUP, "none", CFGF_NONE),
+      CFG_STR_LIST(KEY_VIEW_SORT, "{name}", CFGF_NONE),
+      CFG_END()
+   };
+   
    cfg_opt_t opts[] = {
       CFG_INT(KEY_LOGLEVEL, 2, CFGF_NONE),
       
@@ -64,9 +85,22 @@ void options::load(const char* conf_dir)
       
       CFG_STR(KEY_SKIN_FILE, "", CFGF_NONE),
       CFG_INT(KEY_SNAPSHOT_DELAY, 500, CFGF_NONE),
+      CFG_INT(KEY_TEXT_CACHE, 4096, CFGF_NONE),
+      CFG_INT(KEY_SNAPSHOT_PREFETCH, 2, CFGF_NONE),
+      CFG_INT(KEY_SNAPSHOT_CACHE, 8192, CFGF_NONE),
+      CFG_BOOL(KEY_THUMBNAILS, cfg_true, CFGF_NONE),
+      CFG_INT(KEY_FRAME_RATE, 0, CFGF_NONE),
       
       CFG_STR(KEY_MAME_PATH, "mame %r", CFGF_NONE),
       CFG_STR(KEY_MAME_SNAP_PATH, "", CFGF_NONE),
+      CFG_INT(KEY_MAME_TIMEOUT, 0, CFGF_NONE),
+      CFG_INT_CB(KEY_LAUNCH_MODE, LAUNCH_RESTART, CFGF_NONE, &cb_launch_mode),
+      CFG_STR(KEY_ROM_PATH, "", CFGF_NONE),
+      CFG_INT(KEY_ROM_PRELOAD, 32768, CFGF_NONE),
+      
+      CFG_BOOL(KEY_DATABASE_WAL, cfg_false, CFGF_NONE),
+      
+      CFG_SEC(KEY_VIEW, view_opts, CFGF_MULTI | CFGF_TITLE),
       
       CFG_INT(KEY_KEYCODE_EXIT, 27, CFGF_NONE),
       CFG_INT(KEY_KEYCODE_UP, 273, CFGF_NONE),
@@ -78,6 +112,7 @@ void options::load(const char* conf_dir)
       CFG_INT(KEY_KEYCODE_FAVORITE, 53, CFGF_NONE),
       CFG_INT(KEY_KEYCODE_ALPHAMOD, 64, CFGF_NONE),
       CFG_INT(KEY_KEYCODE_VIEWMOD, 256, CFGF_NONE),
+      CFG_INT(KEY_KEYCODE_SEARCH, 47, CFGF_NONE),
 
       CFG_INT(JOY_AXIS_UP_DOWN, 1, CFGF_NONE),
       CFG_INT(JOY_AXIS_LEFT_RIGHT, 2, CFGF_NONE),
@@ -114,6 +149,12 @@ int options::get_int(const char* key) const
 const char* options::get_string(const char* key) const
 { return cfg_getstr(_cfg, key); }
 
+unsigned int options::get_size(const char* key) const
+{ return cfg_size(_cfg, key); }
+
+cfg_t* options::get_section(const char* key, unsigned int index) const
+{ return cfg_getnsec(_cfg, key, index); }
+
 void options::resolve(string& file) const
 {
    // For now this just inserts the config dir blindly at the beginning of
@@ -38,10 +38,32 @@ namespace ll {
 /* Ui settings */
 #define KEY_SKIN_FILE       "theme"
 #define KEY_SNAPSHOT_DELAY  "snapshot_delay"
+#define KEY_TEXT_CACHE      "text_cache"  /* kilobytes of cached list text */
+#define KEY_SNAPSHOT_PREFETCH "snapshot_prefetch" /* neighbours to preload */
+#define KEY_SNAPSHOT_CACHE  "snapshot_cache" /* kilobytes of cached snapshots */
+#define KEY_THUMBNAILS      "thumbnails" /* keep scaled snapshots on disk */
+#define KEY_FRAME_RATE      "frame_rate" /* max frames per second, 0 = unpaced */
 
 /* MAME settings */
 #define KEY_MAME_PATH       "mame"
 #define KEY_MAME_SNAP_PATH  "snap"
+#define KEY_MAME_TIMEOUT    "mame_timeout" /* maximum session length in seconds, 0 = none */
+#define KEY_LAUNCH_MODE     "launch_mode"  /* restart or video */
+#define KEY_ROM_PATH        "rom_path"     /* directory of rom zips, "" = don't preload */
+#define KEY_ROM_PRELOAD     "rom_preload"  /* kilobytes of roms preloaded per game */
+
+/* What is shut down while mame runs */
+#define LAUNCH_RESTART 0 /* all of sdl */
+#define LAUNCH_VIDEO   1 /* only the screen */
+
+/* Database settings */
+#define KEY_DATABASE_WAL    "database_wal" /* write-ahead logging (true/false) */
+
+/* View sections, one per view in the order they are cycled through */
+#define KEY_VIEW            "view"
+#define KEY_VIEW_FILTER     "filter" /* all, favorite or played */
+#define KEY_VIEW_GROUP      "group"  /* genre, manufacturer, year or none */
+#define KEY_VIEW_SORT       "sort"   /* list of sort keys, '-' for descending */
 
 /* Key mapping */
 #define KEY_KEYCODE_EXIT      "exit"
@@ -54,6 +76,7 @@ namespace ll {
 #define KEY_KEYCODE_FAVORITE  "favorite"
 #define KEY_KEYCODE_ALPHAMOD  "alphamod"
 #define KEY_KEYCODE_VIEWMOD   "viewmod"
+#define KEY_KEYCODE_SEARCH    "search"
 
 /* Joystick mapping */
 #define JOY_AXIS_UP_DOWN      "joy_up_down"
@@ -93,6 +116,12 @@ public:
    /** Returns an option as a string */
    const char* get_string(const char* key) const;
    
+   /** Returns the number of sections with the given name */
+   unsigned int get_size(const char* key) const;
+   
+   /** Returns the index'th section with the given name */
+   cfg_t* get_section(const char* key, unsigned int index) const;
+   
    /**
     * Resolves the path to the file relative to the config dir (set at
     * compile time).
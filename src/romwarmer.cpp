@@ -0,0 +1,164 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "romwarmer.h"
+#include "error.h"
+#include "log.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define WARM_CHUNK (64 * 1024) /* bytes read between checks for cancel */
+
+using namespace ll;
+using namespace std;
+
+/** Rom file extensions the emulator looks for, in the order it does */
+static const char* rom_extensions[] = { ".zip", ".7z", NULL };
+
+rom_warmer::rom_warmer(const string& dir, size_t cap) :
+   _dir(dir), _cap(cap), _thread(NULL), _quit(false), _generation(0),
+   _bytes(0), _files(0), _buffer(WARM_CHUNK)
+{
+   _lock = SDL_CreateMutex();
+   _wake = SDL_CreateCond();
+
+   if (!_lock || !_wake)
+      throw bad_lemon("rom_warmer: unable to create mutex");
+
+   _thread = SDL_CreateThread(&rom_warmer::run, this);
+   if (!_thread)
+      throw bad_lemon("rom_warmer: unable to create thread");
+}
+
+rom_warmer::~rom_warmer()
+{
+   SDL_mutexP(_lock);
+   _quit = true;
+   _generation++;
+   SDL_CondSignal(_wake);
+   SDL_mutexV(_lock);
+
+   SDL_WaitThread(_thread, NULL);
+
+   SDL_DestroyCond(_wake);
+   SDL_DestroyMutex(_lock);
+
+   log << debug << "rom_warmer: read " << _bytes / 1024 << " KB from "
+         << _files << " files" << endl;
+}
+
+void rom_warmer::request(const char* rom, const char* parent)
+{
+   SDL_mutexP(_lock);
+   _roms.clear();
+   _roms.push_back(rom);
+   if (*parent)
+      _roms.push_back(parent);
+   _generation++;
+   SDL_CondSignal(_wake);
+   SDL_mutexV(_lock);
+}
+
+void rom_warmer::cancel()
+{
+   SDL_mutexP(_lock);
+   _roms.clear();
+   _generation++;
+   SDL_mutexV(_lock);
+}
+
+int rom_warmer::run(void* data)
+{
+   ((rom_warmer*)data)->work();
+   return 0;
+}
+
+void rom_warmer::work()
+{
+   SDL_mutexP(_lock);
+
+   while (!_quit) {
+      if (_roms.empty()) {
+         SDL_CondWait(_wake, _lock);
+         continue;
+      }
+
+      vector<string> roms;
+      roms.swap(_roms);
+      Uint32 generation = _generation;
+      size_t budget = _cap;
+
+      SDL_mutexV(_lock);
+
+      bool going = true;
+      for (vector<string>::iterator r = roms.begin(); going && r != roms.end(); r++) {
+         for (int e = 0; going && rom_extensions[e]; e++) {
+            string file(_dir);
+            file.append("/").append(*r).append(rom_extensions[e]);
+            going = warm(file, generation, budget) && budget > 0;
+         }
+      }
+
+      SDL_mutexP(_lock);
+   }
+
+   SDL_mutexV(_lock);
+}
+
+bool rom_warmer::warm(const string& file, Uint32 generation, size_t& budget)
+{
+   int fd = open(file.c_str(), O_RDONLY);
+   if (fd < 0)
+      return true; // not every rom comes in every format
+
+   off_t size = lseek(fd, 0, SEEK_END);
+   bool current = true;
+
+   // the zip directory is at the end and is read first, then the files
+   // from the start for as long as the budget lasts
+   off_t tail = size > WARM_CHUNK? size - WARM_CHUNK : 0;
+   off_t offsets[] = { tail, 0 };
+   off_t ends[] = { size, tail };
+
+   for (int part = 0; current && part < 2; part++) {
+      for (off_t at = offsets[part]; current && at < ends[part] && budget > 0; ) {
+         size_t want = min((size_t)(ends[part] - at), min(budget, (size_t)WARM_CHUNK));
+         ssize_t got = pread(fd, &_buffer[0], want, at);
+         if (got <= 0)
+            break;
+
+         at += got;
+         budget -= got;
+
+         SDL_mutexP(_lock);
+         _bytes += got;
+         current = generation == _generation;
+         SDL_mutexV(_lock);
+      }
+   }
+
+   SDL_mutexP(_lock);
+   _files++;
+   SDL_mutexV(_lock);
+
+   close(fd);
+   return current;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef ROMWARMER_H_
+#define ROMWARMER_H_
+
+#include <SDL/SDL.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace ll {
+
+/**
+ * Reads rom files on a worker thread so they are in the page cache by the
+ * time the emulator opens them.  Only the roms of the game last asked for
+ * are read, asking for another game or cancelling stops the read in
+ * progress at the next chunk.  No more than a fixed number of bytes are
+ * read for each game, so huge sets can't flush the whole cache.
+ *
+ * Nothing in the worker logs.
+ */
+class rom_warmer {
+private:
+   const string _dir;  // directory the rom files are in
+   const size_t _cap;  // bytes to read for each game at most
+
+   SDL_Thread* _thread;
+   SDL_mutex* _lock;
+   SDL_cond* _wake;
+
+   bool _quit;
+   Uint32 _generation; // bumped on every request and cancel
+   vector<string> _roms; // roms still to read, empty when idle
+   unsigned long _bytes; // bytes read so far, for the log
+   unsigned int _files;  // files read so far, for the log
+   vector<char> _buffer; // chunk the worker reads into
+
+   static int run(void* data);
+   void work();
+
+   /**
+    * Reads the file in chunks
+    * @param budget bytes that may still be read, reduced by what was read
+    * @return false if the read was cancelled
+    */
+   bool warm(const string& file, Uint32 generation, size_t& budget);
+
+public:
+   /**
+    * Starts the worker thread
+    * @param dir directory of the rom zip files
+    * @param cap bytes to read for each game at most
+    */
+   rom_warmer(const string& dir, size_t cap);
+
+   /** Stops the worker, interrupting any read in progress */
+   ~rom_warmer();
+
+   /**
+    * Reads the rom files of a game, replacing any pending or running read
+    * @param rom rom name of the game
+    * @param parent rom name of the game it is a clone of, may be empty
+    */
+   void request(const char* rom, const char* parent);
+
+   /** Stops reading, nothing is read until the next request */
+   void cancel();
+};
+
+} // end namespace
+
+#endif /*ROMWARMER_H_*/
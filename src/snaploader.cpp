@@ -0,0 +1,182 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "snaploader.h"
+#include "error.h"
+
+#include <SDL/SDL_image.h>
+
+using namespace ll;
+using namespace std;
+
+snap_loader::snap_loader(lemonui* layout, const thumb_cache* thumbs, int event_code) :
+   _layout(layout), _thumbs(thumbs), _event_code(event_code), _thread(NULL),
+   _quit(false), _pending(false), _generation(0), _cancels(0)
+{
+   _lock = SDL_CreateMutex();
+   _wake = SDL_CreateCond();
+
+   if (!_lock || !_wake)
+      throw bad_lemon("snap_loader: unable to create mutex");
+
+   _thread = SDL_CreateThread(&snap_loader::run, this);
+   if (!_thread)
+      throw bad_lemon("snap_loader: unable to create thread");
+}
+
+snap_loader::~snap_loader()
+{
+   SDL_mutexP(_lock);
+   _quit = true;
+   _generation++;
+   SDL_CondSignal(_wake);
+   SDL_mutexV(_lock);
+
+   SDL_WaitThread(_thread, NULL);
+
+   SDL_DestroyCond(_wake);
+   SDL_DestroyMutex(_lock);
+
+   // free results that were pushed but never handled by the main loop
+   SDL_Event events[16];
+   int count;
+   while ((count = SDL_PeepEvents(events, 16, SDL_GETEVENT,
+         SDL_EVENTMASK(SDL_USEREVENT))) > 0) {
+      for (int i = 0; i < count; i++) {
+         if (events[i].user.code != _event_code)
+            continue;
+
+         snap_result* result = (snap_result*)events[i].user.data1;
+         if (result->surface)
+            SDL_FreeSurface(result->surface);
+         delete result;
+      }
+   }
+}
+
+void snap_loader::request(const char* rom, const string& file)
+{
+   SDL_mutexP(_lock);
+   _rom.assign(rom);
+   _file.assign(file);
+   _pending = true;
+   _generation++;
+   SDL_CondSignal(_wake);
+   SDL_mutexV(_lock);
+}
+
+void snap_loader::prefetch(const vector<snap_request>& requests)
+{
+   SDL_mutexP(_lock);
+   _prefetch.assign(requests.begin(), requests.end());
+   SDL_CondSignal(_wake);
+   SDL_mutexV(_lock);
+}
+
+void snap_loader::cancel()
+{
+   SDL_mutexP(_lock);
+   _pending = false;
+   _prefetch.clear();
+   _generation++;
+   _cancels++;
+   SDL_mutexV(_lock);
+}
+
+int snap_loader::run(void* data)
+{
+   ((snap_loader*)data)->work();
+   return 0;
+}
+
+void snap_loader::work()
+{
+   SDL_mutexP(_lock);
+
+   while (!_quit) {
+      snap_result* result = new snap_result;
+
+      // requested snapshot always goes ahead of the prefetched ones
+      if (_pending) {
+         result->rom = _rom;
+         result->file = _file;
+         result->prefetch = false;
+         _pending = false;
+      } else if (!_prefetch.empty()) {
+         result->rom = _prefetch.front().rom;
+         result->file = _prefetch.front().file;
+         result->prefetch = true;
+         _prefetch.pop_front();
+      } else {
+         delete result;
+         SDL_CondWait(_wake, _lock);
+         continue;
+      }
+
+      Uint32 generation = _generation;
+      Uint32 cancels = _cancels;
+
+      // do the slow part without holding the lock
+      SDL_mutexV(_lock);
+
+      // a valid thumbnail is already scaled and faded
+      result->surface = _thumbs?
+         _thumbs->load(result->rom.c_str(), result->file) : NULL;
+
+      if (!result->surface) {
+         SDL_Surface* raw = IMG_Load(result->file.c_str());
+
+         // skip scaling when the user already moved on
+         SDL_mutexP(_lock);
+         bool stale = result->prefetch?
+               cancels != _cancels : generation != _generation;
+         SDL_mutexV(_lock);
+
+         if (stale) {
+            if (raw) SDL_FreeSurface(raw);
+         } else {
+            result->surface = _layout->prepare_snap(raw);
+
+            if (result->surface && _thumbs)
+               _thumbs->store(result->rom.c_str(), result->file, result->surface);
+         }
+      }
+
+      SDL_mutexP(_lock);
+
+      // results are pushed while holding the lock so cancel can guarantee
+      // nothing stale arrives after it returns
+      if (result->prefetch? cancels == _cancels : generation == _generation) {
+         SDL_Event evt;
+         evt.type = SDL_USEREVENT;
+         evt.user.code = _event_code;
+         evt.user.data1 = result;
+         evt.user.data2 = NULL;
+
+         if (SDL_PushEvent(&evt) == 0)
+            continue;
+      }
+
+      if (result->surface)
+         SDL_FreeSurface(result->surface);
+      delete result;
+   }
+
+   SDL_mutexV(_lock);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef SNAPLOADER_H_
+#define SNAPLOADER_H_
+
+#include <SDL/SDL.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include "lemonui.h"
+#include "thumbcache.h"
+
+using namespace std;
+
+namespace ll {
+
+/**
+ * Result of a snapshot load, passed back to the main loop as data1 of an
+ * SDL user event.  The receiver owns both the result and the surface.
+ */
+struct snap_result {
+   string rom;           // rom name the snapshot was requested for
+   string file;          // image file that was loaded
+   SDL_Surface* surface; // prepared snapshot, or NULL if loading failed
+   bool prefetch;        // loaded ahead of time for a neighbouring item
+};
+
+/** Snapshot to load, identified by rom name */
+struct snap_request {
+   string rom;
+   string file;
+   
+   snap_request(const char* r, const string& f) : rom(r), file(f) { }
+};
+
+/**
+ * Loads, decodes and scales snapshot images on a worker thread so the main
+ * loop never blocks on disk or image decoding.  Only the most recent
+ * request is kept, older requests that have not been picked up yet are
+ * simply replaced.  Prefetch requests are worked on in order once there
+ * is no request pending.
+ */
+class snap_loader {
+private:
+   lemonui* _layout;
+   const thumb_cache* _thumbs; // may be NULL
+   const int _event_code; // user event code for pushing results
+
+   SDL_Thread* _thread;
+   SDL_mutex* _lock;
+   SDL_cond* _wake;
+
+   bool _quit;
+   bool _pending;
+   Uint32 _generation; // bumped on every request and cancel
+   Uint32 _cancels;    // bumped on every cancel, prefetches outlive requests
+   string _rom;
+   string _file;
+   deque<snap_request> _prefetch;
+
+   static int run(void* data);
+   void work();
+
+public:
+   /**
+    * Starts the worker thread
+    * @param layout layout used to scale and fade loaded snapshots
+    * @param thumbs thumbnail cache to try before decoding, or NULL
+    * @param event_code user event code to push results with
+    */
+   snap_loader(lemonui* layout, const thumb_cache* thumbs, int event_code);
+
+   /** Stops the worker and frees any results still queued */
+   ~snap_loader();
+
+   /**
+    * Requests the snapshot for the rom, replacing any pending request.
+    * @param rom rom name echoed back in the result
+    * @param file path of the snapshot image
+    */
+   void request(const char* rom, const string& file);
+
+   /**
+    * Replaces the list of snapshots to load ahead of time.  Results are
+    * pushed with the prefetch flag set, even when a new request is made
+    * while they are being loaded, since they are meant to be cached.
+    */
+   void prefetch(const vector<snap_request>& requests);
+
+   /**
+    * Drops pending requests (including prefetches) and discards the result
+    * of any load in progress.  No result is pushed after this returns until
+    * the next request or prefetch is made.
+    */
+   void cancel();
+};
+
+} // end namespace
+
+#endif /*SNAPLOADER_H_*/
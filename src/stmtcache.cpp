@@ -0,0 +1,81 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "stmtcache.h"
+
+#include <time.h>
+
+using namespace ll;
+using namespace std;
+
+/**
+ * Returns a monotonic microsecond timestamp, SDL_GetTicks is too coarse
+ * for SQL and the wall clock steps when ntp syncs
+ */
+static unsigned long long now_us()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+stmt_cache::stmt_cache(sqlite3* db) : _db(db)
+{
+   reset_timing();
+}
+
+stmt_cache::~stmt_cache()
+{
+   for (map_t::iterator i = _stmts.begin(); i != _stmts.end(); i++)
+      sqlite3_finalize(i->second);
+}
+
+sqlite3_stmt* stmt_cache::get(const char* sql)
+{
+   map_t::iterator i = _stmts.find(sql);
+
+   if (i != _stmts.end()) {
+      sqlite3_reset(i->second);
+      sqlite3_clear_bindings(i->second);
+      return i->second;
+   }
+
+   unsigned long long start = now_us();
+
+   sqlite3_stmt* stmt;
+   if (sqlite3_prepare_v2(_db, sql, -1, &stmt, NULL) != SQLITE_OK)
+      return NULL;
+
+   _prepare_us += now_us() - start;
+   _prepares++;
+
+   _stmts.insert(make_pair(string(sql), stmt));
+   return stmt;
+}
+
+int stmt_cache::step(sqlite3_stmt* stmt)
+{
+   unsigned long long start = now_us();
+   int rc = sqlite3_step(stmt);
+
+   _step_us += now_us() - start;
+   _steps++;
+
+   return rc;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef STMTCACHE_H_
+#define STMTCACHE_H_
+
+#include <sqlite3.h>
+#include <string>
+#include <map>
+
+using namespace std;
+
+namespace ll {
+
+/**
+ * Prepared statements of one database connection, keyed by their SQL.  A
+ * statement is prepared the first time it is asked for and afterwards
+ * only reset and its bindings cleared.  Time spent preparing and stepping
+ * is added up so callers can report what the SQL cost them.
+ *
+ * Nothing in here logs, the db writer uses it from its worker thread.
+ */
+class stmt_cache {
+private:
+   typedef map<string, sqlite3_stmt*> map_t;
+
+   sqlite3* _db;
+   map_t _stmts;
+
+   unsigned long _prepare_us; // microseconds spent preparing
+   unsigned long _step_us;    // microseconds spent stepping
+   unsigned int _prepares;
+   unsigned int _steps;
+
+public:
+   stmt_cache(sqlite3* db);
+
+   /** Finalizes every cached statement, the connection is left open */
+   ~stmt_cache();
+
+   /** Returns the connection the statements belong to */
+   sqlite3* db() const
+   { return _db; }
+
+   /**
+    * Returns the statement for sql, ready to be bound
+    * @return statement owned by the cache, or NULL if preparing failed
+    */
+   sqlite3_stmt* get(const char* sql);
+
+   /** Steps the statement, adding to the step time */
+   int step(sqlite3_stmt* stmt);
+
+   /** Returns the microseconds spent preparing since the last reset */
+   unsigned long prepare_us() const
+   { return _prepare_us; }
+
+   /** Returns the microseconds spent stepping since the last reset */
+   unsigned long step_us() const
+   { return _step_us; }
+
+   /** Returns the number of statements prepared since the last reset */
+   unsigned int prepares() const
+   { return _prepares; }
+
+   /** Returns the number of steps since the last reset */
+   unsigned int steps() const
+   { return _steps; }
+
+   /** Starts adding up times from zero */
+   void reset_timing()
+   { _prepare_us = _step_us = 0; _prepares = _steps = 0; }
+};
+
+} // end namespace
+
+#endif /*STMTCACHE_H_*/
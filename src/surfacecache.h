@@ -0,0 +1,139 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef SURFACECACHE_H_
+#define SURFACECACHE_H_
+
+#include <SDL/SDL.h>
+#include <map>
+#include <list>
+
+using namespace std;
+
+namespace ll {
+
+/**
+ * Least recently used cache of surfaces with a memory budget.  The cache
+ * owns the surfaces it holds and frees them when they are evicted, so
+ * callers must not free a surface returned by get.  The key type must be
+ * usable as a std::map key.
+ */
+template <typename K>
+class surface_cache {
+private:
+   typedef list<K> lru_t;
+
+   struct entry {
+      SDL_Surface* surface;
+      size_t bytes;
+      typename lru_t::iterator lru; // position in the usage list
+   };
+
+   typedef map<K, entry> map_t;
+
+   map_t _entries;
+   lru_t _lru;      // most recently used key at the front
+   size_t _budget;  // maximum number of bytes held
+   size_t _bytes;   // number of bytes currently held
+
+   /** Approximate number of bytes used by the surface pixels */
+   static size_t size_of(SDL_Surface* s)
+   { return (size_t)s->pitch * s->h; }
+
+   /** Evict least recently used surfaces until the budget is met */
+   void trim(size_t budget)
+   {
+      while (_bytes > budget && !_lru.empty()) {
+         typename map_t::iterator i = _entries.find(_lru.back());
+         _bytes -= i->second.bytes;
+         SDL_FreeSurface(i->second.surface);
+         _entries.erase(i);
+         _lru.pop_back();
+      }
+   }
+
+public:
+   /** Creates a cache holding at most budget bytes of pixel data */
+   surface_cache(size_t budget) : _budget(budget), _bytes(0) { }
+
+   /** Frees all surfaces held by the cache */
+   ~surface_cache()
+   { clear(); }
+
+   /**
+    * Returns the surface stored for key and marks it as recently used
+    * @return cached surface, or NULL if key is not cached
+    */
+   SDL_Surface* get(const K& key)
+   {
+      typename map_t::iterator i = _entries.find(key);
+      if (i == _entries.end())
+         return NULL;
+
+      _lru.splice(_lru.begin(), _lru, i->second.lru);
+      return i->second.surface;
+   }
+
+   /**
+    * Stores the surface for key, taking ownership of it.  Surfaces larger
+    * than the whole budget are not kept.
+    * @return true if the cache took ownership of the surface
+    */
+   bool put(const K& key, SDL_Surface* surface)
+   {
+      remove(key);
+
+      size_t bytes = size_of(surface);
+      if (bytes > _budget)
+         return false;
+
+      trim(_budget - bytes);
+
+      _lru.push_front(key);
+      entry e = { surface, bytes, _lru.begin() };
+      _entries.insert(make_pair(key, e));
+      _bytes += bytes;
+      return true;
+   }
+
+   /** Frees the surface stored for key, if any */
+   void remove(const K& key)
+   {
+      typename map_t::iterator i = _entries.find(key);
+      if (i == _entries.end())
+         return;
+
+      _bytes -= i->second.bytes;
+      SDL_FreeSurface(i->second.surface);
+      _lru.erase(i->second.lru);
+      _entries.erase(i);
+   }
+
+   /** Frees all surfaces held by the cache */
+   void clear()
+   { trim(0); }
+
+   /** Returns the number of bytes currently held */
+   size_t bytes() const
+   { return _bytes; }
+};
+
+} // end namespace
+
+#endif /*SURFACECACHE_H_*/
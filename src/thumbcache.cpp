@@ -0,0 +1,195 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "thumbcache.h"
+
+#include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define THUMB_MAGIC 0x48544c4c /* "LLTH" little endian */
+#define THUMB_VERSION 1
+
+using namespace ll;
+using namespace std;
+
+/**
+ * Header written in front of the pixel data.  The file is only ever read
+ * back on the machine that wrote it so fields are in native byte order.
+ */
+struct thumb_header {
+   Uint32 magic;
+   Uint32 version;
+   Uint32 mtime_lo, mtime_hi; // mtime of the source image
+   Uint32 fit_w, fit_h;       // snapshot region the thumbnail was made for
+   Uint32 alpha;              // fade the thumbnail was made with
+   Uint32 w, h, pitch;
+   Uint32 bpp;
+   Uint32 rmask, gmask, bmask;
+};
+
+/** Returns the mtime of the file, or -1 if it doesn't exist */
+static long long source_mtime(const string& file)
+{
+   struct stat st;
+   if (stat(file.c_str(), &st) != 0)
+      return -1;
+
+   return (long long)st.st_mtime;
+}
+
+/**
+ * Checks the pixels the header describes fit the thumbnail region and lie
+ * within the file, so wrapping them in a surface can't read past the map
+ */
+static bool valid(const thumb_header* hdr, size_t size, Uint32 fit_w, Uint32 fit_h)
+{
+   if (hdr->w > fit_w || hdr->h > fit_h)
+      return false;
+
+   if (hdr->bpp != 16 && hdr->bpp != 24 && hdr->bpp != 32)
+      return false;
+
+   if (hdr->pitch < hdr->w * (hdr->bpp / 8))
+      return false;
+
+   return size >= sizeof(thumb_header) +
+         (unsigned long long)hdr->pitch * hdr->h;
+}
+
+thumb_cache::thumb_cache(const string& dir, int fit_w, int fit_h, Uint8 alpha) :
+   _dir(dir), _fit_w(fit_w), _fit_h(fit_h), _alpha(alpha)
+{
+   mkdir(_dir.c_str(), 0755); // fails harmlessly when it already exists
+}
+
+bool thumb_cache::thumb_file(const char* rom, string& file) const
+{
+   if (strchr(rom, '/') != NULL || rom[0] == '.' || rom[0] == '\0')
+      return false;
+
+   file.assign(_dir).append("/").append(rom).append(".thumb");
+   return true;
+}
+
+SDL_Surface* thumb_cache::load(const char* rom, const string& source) const
+{
+   string file;
+   if (!thumb_file(rom, file))
+      return NULL;
+
+   long long mtime = source_mtime(source);
+   if (mtime < 0)
+      return NULL;
+
+   int fd = open(file.c_str(), O_RDONLY);
+   if (fd < 0)
+      return NULL;
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(thumb_header)) {
+      close(fd);
+      return NULL;
+   }
+
+   size_t size = st.st_size;
+   void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+
+   if (map == MAP_FAILED)
+      return NULL;
+
+   const thumb_header* hdr = (const thumb_header*)map;
+   SDL_Surface* thumb = NULL;
+
+   bool ok = hdr->magic == THUMB_MAGIC && hdr->version == THUMB_VERSION &&
+      hdr->mtime_lo == (Uint32)mtime && hdr->mtime_hi == (Uint32)(mtime >> 32) &&
+      hdr->fit_w == _fit_w && hdr->fit_h == _fit_h && hdr->alpha == _alpha &&
+      valid(hdr, size, _fit_w, _fit_h);
+
+   if (ok) {
+      // wrap the mapped pixels and copy them out in one blit
+      SDL_Surface* mapped = SDL_CreateRGBSurfaceFrom(
+         (char*)map + sizeof(thumb_header), hdr->w, hdr->h, hdr->bpp,
+         hdr->pitch, hdr->rmask, hdr->gmask, hdr->bmask, 0);
+
+      if (mapped) {
+         thumb = SDL_ConvertSurface(mapped, mapped->format, SDL_SWSURFACE);
+         SDL_FreeSurface(mapped);
+      }
+   }
+
+   munmap(map, size);
+   return thumb;
+}
+
+void thumb_cache::store(const char* rom, const string& source, SDL_Surface* prepared) const
+{
+   string file;
+   if (!thumb_file(rom, file))
+      return;
+
+   long long mtime = source_mtime(source);
+   if (mtime < 0)
+      return;
+
+   SDL_PixelFormat* fmt = prepared->format;
+
+   thumb_header hdr;
+   hdr.magic = THUMB_MAGIC;
+   hdr.version = THUMB_VERSION;
+   hdr.mtime_lo = (Uint32)mtime;
+   hdr.mtime_hi = (Uint32)(mtime >> 32);
+   hdr.fit_w = _fit_w;
+   hdr.fit_h = _fit_h;
+   hdr.alpha = _alpha;
+   hdr.w = prepared->w;
+   hdr.h = prepared->h;
+   hdr.pitch = prepared->pitch;
+   hdr.bpp = fmt->BitsPerPixel;
+   hdr.rmask = fmt->Rmask;
+   hdr.gmask = fmt->Gmask;
+   hdr.bmask = fmt->Bmask;
+
+   // write to a temporary file first so a partial thumbnail is never read
+   string tmp(file);
+   tmp.append(".tmp");
+
+   FILE* out = fopen(tmp.c_str(), "wb");
+   if (!out)
+      return;
+
+   bool ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1;
+
+   if (ok) {
+      SDL_LockSurface(prepared);
+      ok = fwrite(prepared->pixels, prepared->pitch, prepared->h, out) ==
+         (size_t)prepared->h;
+      SDL_UnlockSurface(prepared);
+   }
+
+   if (fclose(out) != 0)
+      ok = false;
+
+   if (!ok || rename(tmp.c_str(), file.c_str()) != 0)
+      unlink(tmp.c_str());
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef THUMBCACHE_H_
+#define THUMBCACHE_H_
+
+#include <SDL/SDL.h>
+#include <string>
+
+using namespace std;
+
+namespace ll {
+
+/**
+ * On-disk cache of snapshots that have already been scaled and faded for
+ * the theme's snapshot region.  Thumbnails are stored as raw pixels behind
+ * a small header so loading one is an mmap and a copy, with no image
+ * decoding or scaling.  A thumbnail is only used when the mtime of the
+ * source image and the snapshot region/alpha it was made for still match.
+ *
+ * Nothing in here logs, it is used from the snap loader thread.
+ */
+class thumb_cache {
+private:
+   string _dir;
+   Uint32 _fit_w, _fit_h; // snapshot region thumbnails are scaled to
+   Uint32 _alpha;         // fade thumbnails are made with
+
+   /** Sets file to the thumbnail path for rom, false if rom isn't usable */
+   bool thumb_file(const char* rom, string& file) const;
+
+public:
+   /**
+    * Creates the cache directory if it doesn't exist yet
+    * @param dir directory holding the thumbnails
+    * @param fit_w width of the snapshot region
+    * @param fit_h height of the snapshot region
+    * @param alpha fade applied to snapshots
+    */
+   thumb_cache(const string& dir, int fit_w, int fit_h, Uint8 alpha);
+
+   /**
+    * Loads the thumbnail for rom if it is still valid for the source image
+    * @return newly created surface, or NULL if there's no valid thumbnail
+    */
+   SDL_Surface* load(const char* rom, const string& source) const;
+
+   /**
+    * Writes the prepared snapshot as the thumbnail for rom, replacing any
+    * existing one.  Failures are ignored, the cache is only an optimization.
+    */
+   void store(const char* rom, const string& source, SDL_Surface* prepared) const;
+};
+
+} // end namespace
+
+#endif /*THUMBCACHE_H_*/
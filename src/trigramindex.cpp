@@ -0,0 +1,311 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "trigramindex.h"
+#include "log.h"
+
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+#include <unistd.h>
+
+#define TRIGRAM_MAGIC 0x47544c4c /* "LLTG" little endian */
+#define TRIGRAM_VERSION 1
+
+using namespace ll;
+using namespace std;
+
+/** Header written in front of the index, in native byte order */
+struct trigram_header {
+   Uint32 magic;
+   Uint32 version;
+   Uint32 games;
+   Uint32 hash;
+   Uint32 keys;
+   Uint32 postings;
+};
+
+/**
+ * Appends the unique trigrams of the lowercase text to out.  Anything that
+ * isn't a letter or digit separates words, and words are padded with a
+ * space on each side so short words and word starts get trigrams too.
+ */
+static void trigrams(const char* text, vector<Uint32>& out)
+{
+   string norm(" ");
+
+   for (const char* c = text; *c; c++) {
+      char ch = isalnum((unsigned char)*c)? *c : ' ';
+      if (ch != ' ' || norm[norm.size()-1] != ' ')
+         norm.push_back(ch);
+   }
+
+   if (norm[norm.size()-1] != ' ')
+      norm.push_back(' ');
+
+   size_t first = out.size();
+   for (size_t i = 0; i + 3 <= norm.size(); i++)
+      out.push_back((Uint8)norm[i] << 16 | (Uint8)norm[i+1] << 8 | (Uint8)norm[i+2]);
+
+   sort(out.begin() + first, out.end());
+   out.erase(unique(out.begin() + first, out.end()), out.end());
+}
+
+/** FNV-1a hash of everything the index is built from */
+static Uint32 text_hash(const catalog& games)
+{
+   Uint32 hash = 2166136261u;
+
+   for (Uint32 i = 0; i < games.size(); i++) {
+      const char* text[] = { games.folded(i), games.maker(i) };
+
+      for (int t = 0; t < 2; t++) {
+         for (const char* c = text[t]; ; c++) {
+            hash = (hash ^ (Uint8)*c) * 16777619u;
+            if (*c == '\0') break;
+         }
+      }
+   }
+
+   return hash;
+}
+
+/** Orders candidates by score, then play count, then catalog order */
+struct by_rank {
+   const vector<Uint8>& scores;
+   const catalog& games;
+
+   by_rank(const vector<Uint8>& s, const catalog& g) : scores(s), games(g) { }
+
+   bool operator()(Uint32 left, Uint32 right) const
+   {
+      if (scores[left] != scores[right])
+         return scores[left] > scores[right];
+
+      int lc = games.at(left)->count(), rc = games.at(right)->count();
+      if (lc != rc)
+         return lc > rc;
+
+      return left < right;
+   }
+};
+
+trigram_index::trigram_index(const catalog& games, const string& file) :
+   _games(games.size()), _hash(text_hash(games))
+{
+   Uint32 start = SDL_GetTicks();
+
+   if (load(file)) {
+      log << info << "trigram_index: loaded " << _keys.size() << " trigrams in "
+            << SDL_GetTicks() - start << " ms" << endl;
+      return;
+   }
+
+   build(games);
+   save(file);
+
+   log << info << "trigram_index: built " << _keys.size() << " trigrams, "
+         << _postings.size() << " postings in " << SDL_GetTicks() - start
+         << " ms" << endl;
+}
+
+void trigram_index::build(const catalog& games)
+{
+   // trigram in the high word and game in the low word, sorting groups
+   // each trigram's games together in ascending order
+   vector<unsigned long long> pairs;
+   vector<Uint32> grams;
+
+   for (Uint32 i = 0; i < games.size(); i++) {
+      grams.clear();
+      trigrams(games.folded(i), grams);
+      trigrams(games.maker(i), grams);
+
+      for (vector<Uint32>::iterator g = grams.begin(); g != grams.end(); g++)
+         pairs.push_back((unsigned long long)*g << 32 | i);
+   }
+
+   sort(pairs.begin(), pairs.end());
+   pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+
+   _keys.clear();
+   _offsets.clear();
+   _postings.clear();
+   _postings.reserve(pairs.size());
+
+   for (vector<unsigned long long>::iterator p = pairs.begin(); p != pairs.end(); p++) {
+      Uint32 key = (Uint32)(*p >> 32);
+
+      if (_keys.empty() || _keys.back() != key) {
+         _keys.push_back(key);
+         _offsets.push_back(_postings.size());
+      }
+
+      _postings.push_back((Uint32)*p);
+   }
+
+   _offsets.push_back(_postings.size());
+}
+
+/**
+ * Checks the index read from disk can be searched without reading out of
+ * bounds: keys sorted, offsets running from 0 to the end of the postings
+ * and every posting a game in the catalog
+ */
+static bool valid(const vector<Uint32>& keys, const vector<Uint32>& offsets,
+      const vector<Uint32>& postings, Uint32 games)
+{
+   for (size_t k = 1; k < keys.size(); k++)
+      if (keys[k-1] >= keys[k])
+         return false;
+
+   if (offsets.front() != 0 || offsets.back() != postings.size())
+      return false;
+
+   for (size_t o = 1; o < offsets.size(); o++)
+      if (offsets[o-1] > offsets[o])
+         return false;
+
+   for (size_t p = 0; p < postings.size(); p++)
+      if (postings[p] >= games)
+         return false;
+
+   return true;
+}
+
+bool trigram_index::load(const string& file)
+{
+   FILE* in = fopen(file.c_str(), "rb");
+   if (!in)
+      return false;
+
+   trigram_header hdr;
+   bool ok = fread(&hdr, sizeof(hdr), 1, in) == 1 &&
+      hdr.magic == TRIGRAM_MAGIC && hdr.version == TRIGRAM_VERSION &&
+      hdr.games == _games && hdr.hash == _hash;
+
+   // the arrays must fill the rest of the file exactly, so a corrupt
+   // header can't make them huge
+   if (ok) {
+      long body = ftell(in);
+      ok = body >= 0 && fseek(in, 0, SEEK_END) == 0 &&
+         (unsigned long long)(ftell(in) - body) ==
+            ((unsigned long long)hdr.keys * 2 + 1 + hdr.postings) * sizeof(Uint32) &&
+         fseek(in, body, SEEK_SET) == 0;
+   }
+
+   if (ok) {
+      _keys.resize(hdr.keys);
+      _offsets.resize(hdr.keys + 1);
+      _postings.resize(hdr.postings);
+
+      ok = (hdr.keys == 0 || fread(&_keys[0], sizeof(Uint32), hdr.keys, in) == hdr.keys) &&
+         fread(&_offsets[0], sizeof(Uint32), hdr.keys + 1, in) == hdr.keys + 1 &&
+         (hdr.postings == 0 || fread(&_postings[0], sizeof(Uint32), hdr.postings, in) == hdr.postings) &&
+         valid(_keys, _offsets, _postings, _games);
+   }
+
+   fclose(in);
+
+   if (!ok) {
+      _keys.clear();
+      _offsets.clear();
+      _postings.clear();
+   }
+
+   return ok;
+}
+
+void trigram_index::save(const string& file) const
+{
+   if (_keys.empty())
+      return;
+
+   trigram_header hdr;
+   hdr.magic = TRIGRAM_MAGIC;
+   hdr.version = TRIGRAM_VERSION;
+   hdr.games = _games;
+   hdr.hash = _hash;
+   hdr.keys = _keys.size();
+   hdr.postings = _postings.size();
+
+   // write to a temporary file first so a partial index is never read
+   string tmp(file);
+   tmp.append(".tmp");
+
+   FILE* out = fopen(tmp.c_str(), "wb");
+   if (!out) {
+      log << warn << "trigram_index: unable to write " << tmp << endl;
+      return;
+   }
+
+   bool ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1 &&
+      fwrite(&_keys[0], sizeof(Uint32), _keys.size(), out) == _keys.size() &&
+      fwrite(&_offsets[0], sizeof(Uint32), _offsets.size(), out) == _offsets.size() &&
+      fwrite(&_postings[0], sizeof(Uint32), _postings.size(), out) == _postings.size();
+
+   if (fclose(out) != 0)
+      ok = false;
+
+   if (!ok || rename(tmp.c_str(), file.c_str()) != 0) {
+      log << warn << "trigram_index: unable to write " << file << endl;
+      unlink(tmp.c_str());
+   }
+}
+
+void trigram_index::search(const char* query, const catalog& games,
+      const vector<bool>& allowed, int limit, vector<Uint32>& results) const
+{
+   vector<Uint32> grams;
+   trigrams(query, grams);
+
+   // count the query trigrams each game shares
+   vector<Uint8> scores(_games, 0);
+   vector<Uint32> found;
+
+   for (vector<Uint32>::iterator g = grams.begin(); g != grams.end(); g++) {
+      vector<Uint32>::const_iterator k = lower_bound(_keys.begin(), _keys.end(), *g);
+      if (k == _keys.end() || *k != *g)
+         continue;
+
+      size_t key = k - _keys.begin();
+      for (Uint32 p = _offsets[key]; p < _offsets[key+1]; p++) {
+         Uint32 i = _postings[p];
+         if (!allowed[i])
+            continue;
+         if (scores[i] == 0)
+            found.push_back(i);
+         if (scores[i] < 255)
+            scores[i]++;
+      }
+   }
+
+   // games sharing only a trigram or two with a long query are noise
+   Uint8 minimum = (grams.size() + 2) / 3;
+   size_t kept = 0;
+   for (size_t f = 0; f < found.size(); f++)
+      if (scores[found[f]] >= minimum)
+         found[kept++] = found[f];
+   found.resize(kept);
+
+   size_t count = min(found.size(), (size_t)limit);
+   partial_sort(found.begin(), found.begin() + count, found.end(), by_rank(scores, games));
+
+   results.assign(found.begin(), found.begin() + count);
+}
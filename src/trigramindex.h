@@ -0,0 +1,79 @@
+/*
+ * Copyright 2007 Josh Kropf
+ *
+ * This file is part of Lemon Launcher.
+ *
+ * Lemon Launcher is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Lemon Launcher is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Lemon Launcher; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef TRIGRAMINDEX_H_
+#define TRIGRAMINDEX_H_
+
+#include <SDL/SDL.h>
+#include <string>
+#include <vector>
+
+#include "catalog.h"
+
+using namespace std;
+
+namespace ll {
+
+/**
+ * Inverted index from the three letter sequences in game names and
+ * manufacturers to the games containing them.  Lookups score games by how
+ * many of the query trigrams they share, which finds names that are
+ * misspelt, abbreviated or in a different word order.
+ *
+ * The index is saved next to games.db and only rebuilt when the catalog
+ * text it was built from changes.
+ */
+class trigram_index {
+private:
+   vector<Uint32> _keys;     // sorted trigrams
+   vector<Uint32> _offsets;  // postings of _keys[i] start at _offsets[i]
+   vector<Uint32> _postings; // ascending game indexes
+   Uint32 _games;            // number of games indexed
+   Uint32 _hash;             // hash of the indexed text
+
+   void build(const catalog& games);
+   bool load(const string& file);
+   void save(const string& file) const;
+
+public:
+   /**
+    * Loads the saved index for the catalog, building and saving it when
+    * there is none or it was built from different games
+    * @param games catalog to index
+    * @param file where the index is saved
+    */
+   trigram_index(const catalog& games, const string& file);
+
+   /**
+    * Finds the games sharing the most trigrams with the query, ties going
+    * to the most played game
+    * @param query lowercase search text
+    * @param games catalog the index was built from
+    * @param allowed flags the game indexes that may be returned, games not
+    * flagged don't take up any of the limit
+    * @param limit maximum number of results
+    * @param results receives game indexes, best match first
+    */
+   void search(const char* query, const catalog& games,
+         const vector<bool>& allowed, int limit, vector<Uint32>& results) const;
+};
+
+} // end namespace
+
+#endif /*TRIGRAMINDEX_H_*/